@@ -0,0 +1,44 @@
+#pragma once
+#include "database.h"
+#include <string>
+
+// One file holding a compacted copy of the database, behind a short text
+// header:
+//
+//   eraser-snapshot <format>
+//   version=<tool version>
+//   analysis=<analysis version>
+//   schema=<hash of the table definitions>
+//   commit=<commit the analysis is at>
+//   size=<bytes of the database>
+//   checksum=<FNV-1a of the database>
+//
+// followed by an empty line and the database itself. A snapshot only restores
+// into a tool of the same analysis version and schema.
+class AnalysisSnapshot {
+public:
+  static const int format;
+  explicit AnalysisSnapshot(std::string path);
+  virtual ~AnalysisSnapshot() = default;
+
+  // fails when the database has no finished run to take a snapshot of
+  bool write(Database *db);
+  bool readHeader();
+  // checks the header and the checksum before replacing the database
+  bool restore(const std::string &dbPath);
+  std::string getPath();
+  std::string getCommitHash();
+
+private:
+  std::string path;
+  int fileFormat = 0;
+  std::string version;
+  int snapshotAnalysisVersion = 0;
+  std::string schemaHash;
+  std::string commitHash;
+  long long size = 0;
+  std::string checksum;
+};
+
+// hash of the tables, indexes and triggers the database defines
+std::string getSchemaHash(Database *db);
@@ -0,0 +1,33 @@
+#pragma once
+#include "database.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// Named analysis databases kept side by side in one directory, for example
+// one per branch, so that analysing one branch leaves the others in place. A
+// new baseline is forked from the one analysed at the nearest ancestor of its
+// first commit.
+class BaselineStore {
+public:
+  static const std::string defaultDirectory;
+  explicit BaselineStore(std::string directory = defaultDirectory);
+  virtual ~BaselineStore() = default;
+
+  // names become file names in the directory, so they cannot hold a path
+  static bool isValidName(const std::string &name);
+
+  std::string getPath(const std::string &name);
+  bool exists(const std::string &name);
+  // name -> commit of the last finished run, baselines with an interrupted
+  // run or another analysis version are left out as they cannot be forked
+  std::map<std::string, std::string> getBaselines();
+  // the baseline analysed at the first of the ancestors, "" if there is none
+  std::string findParent(const std::vector<std::string> &ancestors);
+  // clones the file where the file system supports copy on write and copies
+  // it otherwise, with a warning as a copy takes as long as the file is big
+  bool fork(const std::string &parent, const std::string &name);
+
+private:
+  std::string directory;
+};
@@ -3,6 +3,7 @@
 #include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <set>
 #include <sqlite3.h>
 #include <string>
 #include <vector>
@@ -18,6 +19,18 @@ public:
   std::vector<std::string>
   functionVariableLocksetsOrdering(std::vector<std::string> functions);
   bool shouldVisitNode(std::string funcName);
+  // the roots and every function they call or start threads on, directly or
+  // not
+  std::set<std::string>
+  getReachableFunctions(const std::set<std::string> &roots);
+  // the same, leaving out functions that are stale in this run and those
+  // only reachable through them
+  std::set<std::string>
+  getCurrentReachableFunctions(const std::set<std::string> &roots);
+  // widened functions keep the flag until their file is parsed again
+  void markNodeAsWidened(std::string funcName);
+  std::set<std::string> getWidenedNodes();
+  std::set<std::string> getWidenedFiles();
   void markNodesAsStale(std::string fileName);
   void deleteStaleNodes();
   std::string getFilenameFromFuncname(std::string funcName);
@@ -27,4 +40,6 @@ private:
   std::vector<std::string> traverseGraph(bool reverse);
   std::vector<std::string> getNextNodes(std::vector<std::string> &order);
   void markNodes(std::vector<std::string> &startNodes, bool reverse);
+  std::set<std::string> queryReachableFunctions(
+      const std::set<std::string> &roots, bool current);
 };
\ No newline at end of file
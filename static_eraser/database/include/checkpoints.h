@@ -0,0 +1,52 @@
+#pragma once
+#include "database.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Progress of the current run, written inside the transactions of the work it
+// describes so that an interrupted run can resume from its last commit. Each
+// phase stores the items it works through (files or an ordering of functions)
+// and how many of them are done. A run is unfinished from startRun until
+// finishRun.
+class Checkpoints {
+public:
+  explicit Checkpoints(Database *db);
+  virtual ~Checkpoints() = default;
+
+  bool hasUnfinishedRun();
+  // discards the progress of any earlier run and starts parsing the files
+  void startRun(const std::vector<std::string> &files);
+  void finishRun();
+
+  // phases finished by the run that is being resumed
+  bool isPhaseFinished(const std::string &phase);
+  // loads the items and position of the phase when the run stopped during it
+  bool resumePhase(const std::string &phase, std::vector<std::string> &items);
+  void startPhase(const std::string &phase,
+                  const std::vector<std::string> &items);
+  // the first item the phase has not finished
+  int getPosition();
+  // called once the items before position are done, commits the phase
+  // transaction and begins it again when the interval has passed
+  void itemFinished(int position);
+  // saves the position, the phase transaction still has to be committed
+  void finishPhase();
+  void setInterval(long long intervalMs);
+
+  // functions the phases need beyond their own items, kind is either
+  // 'changed' or 'deferred'
+  void addFunctions(const std::string &kind,
+                    const std::vector<std::string> &functions);
+  std::vector<std::string> getFunctions(const std::string &kind);
+
+private:
+  Database *db;
+  std::string phase = "";
+  int position = 0;
+  long long intervalMs = 10000;
+  std::chrono::steady_clock::time_point lastCommit;
+
+  std::string getStoredPhase();
+  void savePosition();
+};
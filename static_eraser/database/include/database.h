@@ -6,16 +6,22 @@
 #include <string>
 #include <vector>
 
+class SqlProfiler;
+
 class Database {
 public:
   static const std::string dbName;
-  explicit Database(bool initialCommit);
+  explicit Database(bool initialCommit, std::string dbPath = dbName);
   virtual ~Database();
 
   void prepareStatement(sqlite3_stmt *&stmt, std::string query,
                         std::vector<std::string> &params);
   void prepareStatement(sqlite3_stmt *&stmt, std::string query);
   void runStatement(sqlite3_stmt *stmt);
+  // groups the statements up to the matching commit into one transaction,
+  // nested calls join the outermost transaction
+  void beginTransaction(std::string name);
+  void commitTransaction();
   void deleteDatabase();
   void createTable(std::string query, std::string tableName);
   void createTables();
@@ -25,7 +31,21 @@ public:
   bool retrieveBoolean(std::string value);
   std::string getStringFromStatement(sqlite3_stmt *stmt, int col);
 
+  // number of statements prepared on this connection
+  long long getStatementCount();
+
+  // starts aggregating every statement run on this connection
+  void enableProfiling();
+  SqlProfiler *getProfiler();
+  std::string getPath();
+
 private:
+  std::string dbPath;
+  long long statementCount = 0;
+  int transactionDepth = 0;
+  std::string transactionName;
+  long long transactionStart = 0;
+  SqlProfiler *profiler = nullptr;
   char *errMsg = 0;
   sqlite3 *db;
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include "database.h"
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Deletes rows left behind by functions, files, tests and locksets that no
+// longer exist, then rebuilds the indexes, refreshes the planner statistics and
+// vacuums the file. Functions that are still called or defined in a file on
+// disk keep all their rows.
+class DatabaseMaintenance {
+public:
+  explicit DatabaseMaintenance(Database *db);
+  virtual ~DatabaseMaintenance() = default;
+
+  long long getSizeBytes();
+  // share of the pages of the file that are free
+  double getFreeFraction();
+  void collectGarbage();
+  void printReport(std::ostream &stream);
+
+private:
+  Database *db;
+  long long bytesBefore = 0;
+  long long bytesAfter = 0;
+  int missingFiles = 0;
+  std::map<std::string, long long> rowsDeleted = {};
+
+  long long getPragma(const std::string &pragma);
+  std::vector<std::string> getTables();
+  long long countRows(const std::string &table);
+  void runQuery(const std::string &query,
+                std::vector<std::string> params = {});
+  std::vector<std::string> getMissingFiles();
+  void deleteOrphans();
+};
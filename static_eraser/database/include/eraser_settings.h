@@ -5,8 +5,17 @@ class EraserSettings {
 public:
   explicit EraserSettings(Database *db);
   virtual ~EraserSettings() = default;
-  std::string getAndUpdatePrevHash(std::string commitHash);
+  std::string getPrevHash();
+  // only set once a run is finished, so that an interrupted run is diffed
+  // from the same commit when it starts again
+  void setPrevHash(std::string commitHash);
+  // the analysisVersion of the build that created the tables, 0 for
+  // databases from before it was recorded
+  int getAnalysisVersion();
+  // false when the results were computed by a build with other tables or
+  // another analysis, they cannot be updated incrementally
+  bool hasCurrentAnalysisVersion();
 
 private:
   Database *db;
-};
\ No newline at end of file
+};
@@ -12,24 +12,7 @@
 #include <vector>
 
 struct TestVariableLocks
-    : public std::unordered_map<std::string, VariableLocks> {
-  TestVariableLocks &operator*=(const TestVariableLocks &other) {
-    for (auto it = begin(); it != end();) {
-      if (other.find(it->first) != other.end()) {
-        it->second *= other.at(it->first);
-        ++it;
-      } else {
-        it = erase(it);
-      }
-    }
-    return *this;
-  }
-
-  TestVariableLocks operator*(const TestVariableLocks &other) const {
-    TestVariableLocks result = *this;
-    return result *= other;
-  }
-};
+    : public std::unordered_map<std::string, VariableLocks> {};
 
 struct FunctionCumulativeData {
   TestVariableLocks locksets;
@@ -51,9 +34,15 @@ public:
       Database *db, FunctionVariableLocksets *functionVariableLocksets);
   virtual ~FunctionCumulativeLocksets() = default;
   bool shouldVisitNode(std::string funcName);
-  void updateFunctionCumulativeLocksets(std::string funcName);
+  // returns the new cumulative data of the function
+  FunctionCumulativeData
+  updateFunctionCumulativeLocksets(std::string funcName);
   std::vector<std::string> getFunctionsForTesting();
-  std::set<std::string> detectDataRaces();
+  // variables whose state in the function's phase 1 summary is shared
+  // modified
+  std::set<std::string> getSharedModifiedVariables(std::string funcName);
+  // races between the threads reachable from root, under the root's test
+  std::set<std::string> detectDataRaces(std::string root);
 
 private:
   std::set<std::string> getFunctionCumulativeAccesses(std::string funcName);
@@ -62,10 +51,15 @@ private:
   std::set<std::string> computeFunctionCumulativeAccesses(std::string funcName);
   TestVariableLocks computeFunctionCumulativeLocksets(std::string funcName);
   FunctionCumulativeData computeFunctionCumulativeData(std::string funcName);
+  // keeps the tests of both, variables found in only one of them keep
+  // their lockset
+  void intersectTestVariableLocks(TestVariableLocks &testVariableLocks,
+                                  const TestVariableLocks &other);
   void deleteFunctionCumulativeData(std::string funcName);
   void
   insertFunctionCumulativeData(std::string funcName,
                                FunctionCumulativeData functionCumulativeData);
   Database *db;
   FunctionVariableLocksets *functionVariableLocksets;
+  LocksetTable *locksetTable;
 };
\ No newline at end of file
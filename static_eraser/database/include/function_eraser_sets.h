@@ -8,6 +8,12 @@
 #include <string>
 #include <vector>
 
+// The sets of a function with the table their variable ids index
+struct InternedEraserSets {
+  VarTable varTable;
+  EraserSets sets = EraserSets::defaultValue;
+};
+
 class FunctionEraserSets {
 public:
   explicit FunctionEraserSets(Database *db);
@@ -15,24 +21,34 @@ public:
 
   void combineSets(EraserSets &s1, EraserSets &s2);
   void combineSetsForRecursiveThreads(EraserSets &s1, EraserSets &s2);
-  EraserSets *getEraserSets(std::string funcName);
+  const InternedEraserSets &getInternedSets(std::string funcName);
+  // the sets of funcName with its variables interned into varTable
+  EraserSets getEraserSets(std::string funcName, VarTable &varTable);
+  EraserSets *getCurrEraserSets();
+  // the variables of the sets of the current function
+  VarTable &getCurrVarTable();
   void updateCurrEraserSets(EraserSets &sets);
   void saveCurrEraserSets();
   void startNewFunction(std::string funcName);
+  // drops the sets of the current function but keeps its variables
+  void resetCurrEraserSets();
   void markFunctionEraserSetsAsOld();
-  void saveFunctionDirectVariableAccesses(std::set<std::string> &reads,
-                                          std::set<std::string> &writes);
+  // sets cached by an earlier run may belong to deleted functions
+  void clearCache();
+  void saveFunctionDirectVariableAccesses(std::set<VarId> &reads,
+                                          std::set<VarId> &writes);
   void saveRecursiveUnlocks(std::set<std::string> &unlocks);
 
 private:
   bool checkCurrFuncInDb();
   void insertCurrSetsIntoDb(bool locksChanged, bool varsChanged);
   void deleteCurrFuncFromDb();
-  EraserSets extractSetsFromDb(std::string funcName);
+  EraserSets extractSetsFromDb(std::string funcName, VarTable &varTable);
 
   Database *db;
-  std::unordered_map<std::string, EraserSets> functionSets;
+  std::unordered_map<std::string, InternedEraserSets> functionSets;
   std::string currFunc;
+  VarTable currVarTable;
   EraserSets currFuncSets;
   bool currFuncSetsStarted;
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "database.h"
+#include "lockset_table.h"
 #include "variable_locks.h"
 #include <cstdio>
 #include <fstream>
@@ -18,20 +19,48 @@ public:
   explicit FunctionVariableLocksets(Database *db);
   virtual ~FunctionVariableLocksets() = default;
 
+  // Every root is analysed under a test of the same name that starts with no
+  // locks held. Tests of roots that are no longer configured are deleted and
+  // new roots are marked as changed so that phase 2 visits them.
+  void updateRoots(const std::set<std::string> &roots);
   void startNewFunction(std::string funcName);
   void startNewTest(std::string testName);
   void applyDeltaLockset(std::set<std::string> &locks, std::string funcName);
+  // locks no longer held before a call to funcName that are still not held
+  // after it, i.e. removedLocks minus the locks funcName acquires
+  void applyDeltaLocksetToRemovedLocks(std::set<std::string> &removedLocks,
+                                       std::string funcName);
   FunctionInputs updateAndCheckCombinedInputs();
   bool shouldVisitNode(std::string funcName);
   void addFuncCallLocksets(
       std::unordered_map<std::string, std::set<std::string>> funcCallLocksets);
   void addVariableLocksets(
       std::unordered_map<std::string, std::set<std::string>> variableLocksets);
+  // Results of phase 2 on a function, keyed by a hash of its CFG and the
+  // lock summaries of its callees and by the locks held on entry. The memo
+  // outlives commits, so an unchanged function analysed under a lockset it
+  // has seen before is not analysed again.
+  bool getMemoisedLocksets(
+      std::string cfgHash, const std::set<std::string> &inputLocks,
+      std::unordered_map<std::string, std::set<std::string>> &funcCallLocksets,
+      std::unordered_map<std::string, std::set<std::string>>
+          &variableLocksets);
+  void memoiseLocksets(
+      std::string cfgHash, const std::set<std::string> &inputLocks,
+      const std::unordered_map<std::string, std::set<std::string>>
+          &funcCallLocksets,
+      const std::unordered_map<std::string, std::set<std::string>>
+          &variableLocksets);
+  void getFunctionLocks(std::string funcName, std::set<std::string> &dbLocks,
+                        std::set<std::string> &dbUnlocks);
   VariableLocks getVariableLocks();
   VariableLocks getVariableLocks(std::string func, std::string id);
   void markFunctionVariableLocksetsAsOld();
+  // lock summaries cached by an earlier run are outdated once phase 1 reruns
+  void clearCache();
   std::set<std::string> getFunctionRecursiveUnlocks();
   std::vector<std::string> getFunctionsForTesting();
+  LocksetTable *getLocksetTable();
 
 private:
   void extractFunctionLocksFromDb(std::string funcName,
@@ -40,11 +69,11 @@ private:
   std::string getId(std::string funcName, std::string testName);
 
   Database *db;
-  std::unordered_map<std::string, VariableLocks> functionSets;
+  LocksetTable locksetTable;
+  std::set<std::string> roots;
   std::unordered_map<std::string, std::set<std::string>> functionLocks;
   std::unordered_map<std::string, std::set<std::string>> functionUnlocks;
   std::string currFunc;
   std::string currTest;
   std::string currId;
-  VariableLocks currFuncSets;
 };
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include "database.h"
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+typedef uint32_t LocksetId;
+
+// Stores every distinct lockset once, in the locksets table, and refers to it
+// by its row id, like the lockset index of the original Eraser. Locksets are
+// cached per connection and intersections are memoised by id pair, so a set
+// of locks is only ever intersected once per run.
+class LocksetTable {
+public:
+  explicit LocksetTable(Database *db);
+  virtual ~LocksetTable() = default;
+
+  LocksetId intern(const std::set<std::string> &locks);
+  const std::set<std::string> &get(LocksetId id);
+  LocksetId intersect(LocksetId a, LocksetId b);
+  LocksetId getEmpty();
+
+private:
+  static std::string createKey(const std::set<std::string> &locks);
+  void cache(LocksetId id, const std::string &key,
+             const std::set<std::string> &locks);
+
+  Database *db;
+  LocksetId emptyId = 0;
+  std::unordered_map<std::string, LocksetId> ids;
+  std::unordered_map<LocksetId, std::set<std::string>> locksets;
+  std::unordered_map<uint64_t, LocksetId> intersections;
+};
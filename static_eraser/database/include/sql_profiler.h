@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <ostream>
+#include <sqlite3.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct PendingStatement {
+  std::chrono::steady_clock::time_point start;
+  long long rows = 0;
+};
+
+struct QueryProfile {
+  std::string query;
+  // one unnormalised instance of the query, used for EXPLAIN QUERY PLAN
+  std::string example;
+  long long calls = 0;
+  long long totalNs = 0;
+  long long rows = 0;
+  long long vmSteps = 0;
+  long long fullScanSteps = 0;
+  std::string plan;
+};
+
+// Aggregates every statement run on a connection by normalised query text,
+// using sqlite3_trace_v2 for timings and returned rows and
+// sqlite3_stmt_status for VM and full scan steps. Statements are timed with
+// steady_clock from their first step, as the profile event only has
+// millisecond resolution on some builds.
+class SqlProfiler {
+public:
+  explicit SqlProfiler(sqlite3 *db);
+  virtual ~SqlProfiler();
+
+  // profiles sorted by total time, slowest first
+  std::vector<QueryProfile> getProfiles();
+  void printReport(std::ostream &stream, int top);
+  bool writeCsv(const std::string &path);
+
+  static std::string normalizeQuery(const char *sql);
+
+private:
+  static int traceCallback(unsigned int type, void *context, void *p,
+                           void *x);
+  void recordStart(sqlite3_stmt *stmt);
+  void recordRow(sqlite3_stmt *stmt);
+  void recordProfile(sqlite3_stmt *stmt, long long ns);
+  void startTracing();
+  std::string explainQueryPlan(const std::string &sql);
+
+  sqlite3 *db;
+  std::unordered_map<std::string, QueryProfile> profiles;
+  std::unordered_map<sqlite3_stmt *, PendingStatement> pending;
+};
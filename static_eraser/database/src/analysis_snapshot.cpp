@@ -0,0 +1,193 @@
+#include "analysis_snapshot.h"
+#include "analysis_version.h"
+#include "checkpoints.h"
+#include "eraser_settings.h"
+#include "fnv_hash.h"
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+#ifndef ERASER_VERSION
+#define ERASER_VERSION "unknown"
+#endif
+
+const int AnalysisSnapshot::format = 1;
+
+static std::string toHex(uint64_t value) {
+  std::ostringstream stream;
+  stream << std::hex << std::setw(16) << std::setfill('0') << value;
+  return stream.str();
+}
+
+std::string getSchemaHash(Database *db) {
+  sqlite3_stmt *stmt;
+  // sqlite_stat1 only exists once ANALYZE has run
+  db->prepareStatement(stmt, "SELECT type, name, sql FROM sqlite_master WHERE "
+                             "name NOT LIKE 'sqlite_%' ORDER BY type, name;");
+  std::string schema;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    for (int col = 0; col < 3; col++) {
+      schema += db->getStringFromStatement(stmt, col) + "\n";
+    }
+  }
+  sqlite3_finalize(stmt);
+  return toHex(fnvHash(schema.data(), schema.size()));
+}
+
+AnalysisSnapshot::AnalysisSnapshot(std::string path) : path(path){};
+
+std::string AnalysisSnapshot::getPath() { return path; }
+
+std::string AnalysisSnapshot::getCommitHash() { return commitHash; }
+
+bool AnalysisSnapshot::write(Database *db) {
+  if (!EraserSettings(db).hasCurrentAnalysisVersion()) {
+    std::cerr << "The database was written with another analysis version, "
+                 "analyse a commit before taking a snapshot"
+              << std::endl;
+    return false;
+  }
+  if (Checkpoints(db).hasUnfinishedRun()) {
+    std::cerr << "The previous run was interrupted, resume it before taking "
+                 "a snapshot"
+              << std::endl;
+    return false;
+  }
+  commitHash = EraserSettings(db).getPrevHash();
+  if (commitHash == "") {
+    std::cerr << "The database has no finished run to take a snapshot of"
+              << std::endl;
+    return false;
+  }
+
+  // VACUUM INTO leaves out the free pages and the write-ahead log
+  std::string copyPath = path + ".tmp";
+  std::remove(copyPath.c_str());
+  sqlite3_stmt *stmt;
+  std::vector<std::string> params = {copyPath};
+  db->prepareStatement(stmt, "VACUUM INTO ?;", params);
+  db->runStatement(stmt);
+  std::ifstream copy(copyPath, std::ios::binary);
+  if (!copy.is_open()) {
+    std::cerr << "Failed to copy the database to " << copyPath << std::endl;
+    return false;
+  }
+  std::string contents((std::istreambuf_iterator<char>(copy)),
+                       std::istreambuf_iterator<char>());
+  copy.close();
+  std::remove(copyPath.c_str());
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open " << path << " for writing." << std::endl;
+    return false;
+  }
+  fileFormat = format;
+  version = ERASER_VERSION;
+  snapshotAnalysisVersion = analysisVersion;
+  schemaHash = getSchemaHash(db);
+  size = contents.size();
+  checksum = toHex(fnvHash(contents.data(), contents.size()));
+  file << "eraser-snapshot " << fileFormat << "\n"
+       << "version=" << version << "\n"
+       << "analysis=" << snapshotAnalysisVersion << "\n"
+       << "schema=" << schemaHash << "\n"
+       << "commit=" << commitHash << "\n"
+       << "size=" << size << "\n"
+       << "checksum=" << checksum << "\n\n";
+  file.write(contents.data(), contents.size());
+  return file.good();
+}
+
+bool AnalysisSnapshot::readHeader() {
+  std::ifstream file(path, std::ios::binary);
+  std::string line;
+  if (!std::getline(file, line) || line.rfind("eraser-snapshot ", 0) != 0) {
+    return false;
+  }
+  fileFormat = std::atoi(line.substr(std::string("eraser-snapshot ").size())
+                             .c_str());
+  while (std::getline(file, line) && !line.empty()) {
+    size_t separator = line.find('=');
+    if (separator == std::string::npos) {
+      return false;
+    }
+    std::string key = line.substr(0, separator);
+    std::string value = line.substr(separator + 1);
+    if (key == "version") {
+      version = value;
+    } else if (key == "analysis") {
+      snapshotAnalysisVersion = std::atoi(value.c_str());
+    } else if (key == "schema") {
+      schemaHash = value;
+    } else if (key == "commit") {
+      commitHash = value;
+    } else if (key == "size") {
+      size = std::atoll(value.c_str());
+    } else if (key == "checksum") {
+      checksum = value;
+    }
+  }
+  return file.good() && commitHash != "";
+}
+
+bool AnalysisSnapshot::restore(const std::string &dbPath) {
+  if (!readHeader()) {
+    std::cerr << path << " is not an analysis snapshot" << std::endl;
+    return false;
+  }
+  if (fileFormat != format) {
+    std::cerr << path << " has snapshot format " << fileFormat
+              << ", expected " << format << std::endl;
+    return false;
+  }
+  // the tool version is only recorded, releases that leave the analysis
+  // alone can share snapshots
+  if (snapshotAnalysisVersion != analysisVersion) {
+    std::cerr << path << " was taken by " << version
+              << " with analysis version " << snapshotAnalysisVersion
+              << ", expected " << analysisVersion << std::endl;
+    return false;
+  }
+  Database expected(false, ":memory:");
+  expected.createTables();
+  if (schemaHash != getSchemaHash(&expected)) {
+    std::cerr << path << " has tables this version does not use" << std::endl;
+    return false;
+  }
+
+  std::ifstream file(path, std::ios::binary);
+  std::string line;
+  while (std::getline(file, line) && !line.empty()) {
+  }
+  std::string contents((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+  if ((long long)contents.size() != size ||
+      toHex(fnvHash(contents.data(), contents.size())) != checksum) {
+    std::cerr << path << " is corrupt, its checksum does not match"
+              << std::endl;
+    return false;
+  }
+
+  // written next to the database first so that a failed write leaves the
+  // old database in place
+  std::string restorePath = dbPath + ".restore";
+  std::ofstream restored(restorePath, std::ios::binary);
+  restored.write(contents.data(), contents.size());
+  restored.close();
+  if (!restored.good()) {
+    std::cerr << "Failed to write " << restorePath << std::endl;
+    std::remove(restorePath.c_str());
+    return false;
+  }
+  std::remove((dbPath + "-wal").c_str());
+  std::remove((dbPath + "-shm").c_str());
+  std::error_code error;
+  std::filesystem::rename(restorePath, dbPath, error);
+  if (error) {
+    std::cerr << "Failed to replace " << dbPath << ": " << error.message()
+              << std::endl;
+    return false;
+  }
+  return true;
+}
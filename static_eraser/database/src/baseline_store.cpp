@@ -0,0 +1,122 @@
+#include "baseline_store.h"
+#include "checkpoints.h"
+#include "eraser_settings.h"
+#include "metrics.h"
+#include <filesystem>
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+const std::string BaselineStore::defaultDirectory = "eraser_baselines";
+
+BaselineStore::BaselineStore(std::string directory) : directory(directory){};
+
+bool BaselineStore::isValidName(const std::string &name) {
+  return !name.empty() && name.find('/') == std::string::npos &&
+         name.find("..") == std::string::npos;
+}
+
+std::string BaselineStore::getPath(const std::string &name) {
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  return directory + "/" + name + ".db";
+}
+
+bool BaselineStore::exists(const std::string &name) {
+  return std::filesystem::exists(directory + "/" + name + ".db");
+}
+
+std::map<std::string, std::string> BaselineStore::getBaselines() {
+  std::map<std::string, std::string> baselines;
+  std::error_code error;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(directory, error)) {
+    if (entry.path().extension() != ".db") {
+      continue;
+    }
+    Database db(false, entry.path().string());
+    EraserSettings settings(&db);
+    if (!settings.hasCurrentAnalysisVersion()) {
+      continue;
+    }
+    std::string commitHash = settings.getPrevHash();
+    if (commitHash != "" && !Checkpoints(&db).hasUnfinishedRun()) {
+      baselines[entry.path().stem().string()] = commitHash;
+    }
+  }
+  return baselines;
+}
+
+std::string
+BaselineStore::findParent(const std::vector<std::string> &ancestors) {
+  std::map<std::string, std::string> baselines = getBaselines();
+  for (const std::string &commitHash : ancestors) {
+    for (const auto &pair : baselines) {
+      if (pair.second == commitHash) {
+        return pair.first;
+      }
+    }
+  }
+  return "";
+}
+
+bool BaselineStore::fork(const std::string &parent, const std::string &name) {
+  std::string parentPath = getPath(parent);
+  std::string path = getPath(name);
+  {
+    // moves the write-ahead log into the file, so that the fork has every
+    // commit of the parent
+    Database parentDb(false, parentPath);
+    sqlite3_stmt *stmt;
+    parentDb.prepareStatement(stmt, "PRAGMA wal_checkpoint(TRUNCATE);");
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    }
+    sqlite3_finalize(stmt);
+  }
+
+  std::string forkPath = path + ".fork";
+  bool cloned = false;
+#ifdef FICLONE
+  int source = open(parentPath.c_str(), O_RDONLY);
+  int target = open(forkPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (source >= 0 && target >= 0) {
+    cloned = ioctl(target, FICLONE, source) == 0;
+  }
+  if (source >= 0) {
+    close(source);
+  }
+  if (target >= 0) {
+    close(target);
+  }
+#endif
+  std::error_code error;
+  if (!cloned) {
+    std::cerr << "Warning: the file system of " << directory
+              << " cannot clone files, copying " << parentPath << " instead"
+              << std::endl;
+    std::filesystem::copy_file(
+        parentPath, forkPath,
+        std::filesystem::copy_options::overwrite_existing, error);
+    if (error) {
+      std::cerr << "Failed to copy " << parentPath << ": " << error.message()
+                << std::endl;
+      std::remove(forkPath.c_str());
+      return false;
+    }
+  }
+  std::filesystem::rename(forkPath, path, error);
+  if (error) {
+    std::cerr << "Failed to create " << path << ": " << error.message()
+              << std::endl;
+    return false;
+  }
+  if (cloned) {
+    metricCount("baselines_cloned", 1);
+  } else {
+    metricCount("baselines_copied", 1);
+  }
+  return true;
+}
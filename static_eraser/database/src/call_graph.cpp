@@ -6,7 +6,8 @@ void CallGraph::addNode(std::string funcName, std::string fileName) {
   std::string query =
       "INSERT INTO functions_table (funcname, filename) VALUES (?, ?) "
       "ON CONFLICT(funcname) DO UPDATE SET "
-      "stale = 0, recently_changed = 1, filename = excluded.filename;";
+      "stale = 0, recently_changed = 1, widened = 0, "
+      "filename = excluded.filename;";
 
   sqlite3_stmt *stmt;
   std::vector<std::string> params = {funcName, fileName};
@@ -224,6 +225,82 @@ bool CallGraph::shouldVisitNode(std::string funcName) {
   return result;
 }
 
+std::set<std::string>
+CallGraph::getReachableFunctions(const std::set<std::string> &roots) {
+  return queryReachableFunctions(roots, false);
+}
+
+std::set<std::string>
+CallGraph::getCurrentReachableFunctions(const std::set<std::string> &roots) {
+  return queryReachableFunctions(roots, true);
+}
+
+std::set<std::string>
+CallGraph::queryReachableFunctions(const std::set<std::string> &roots,
+                                   bool current) {
+  std::vector<std::string> params(roots.begin(), roots.end());
+  std::string rootFilter = current ? " AND stale = 0" : "";
+  std::string calleeFilter =
+      current ? " JOIN functions_table"
+                " ON functions_table.funcname = function_calls.callee"
+                " WHERE functions_table.stale = 0"
+              : "";
+  std::string query =
+      "WITH RECURSIVE reachable(funcname) AS ("
+      " SELECT funcname FROM functions_table WHERE funcname IN " +
+      db->createTupleList(params) + rootFilter +
+      " UNION SELECT function_calls.callee FROM function_calls"
+      " JOIN reachable ON function_calls.caller = reachable.funcname" +
+      calleeFilter + ") SELECT funcname FROM reachable;";
+
+  sqlite3_stmt *stmt;
+  db->prepareStatement(stmt, query, params);
+  std::set<std::string> reachable = {};
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    reachable.insert(db->getStringFromStatement(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  return reachable;
+}
+
+void CallGraph::markNodeAsWidened(std::string funcName) {
+  sqlite3_stmt *stmt;
+  std::string query =
+      "UPDATE functions_table SET widened = 1 WHERE funcname = ?;";
+
+  std::vector<std::string> params = {funcName};
+  db->prepareStatement(stmt, query, params);
+  db->runStatement(stmt);
+}
+
+std::set<std::string> CallGraph::getWidenedNodes() {
+  sqlite3_stmt *stmt;
+  std::string query =
+      "SELECT funcname FROM functions_table WHERE widened = 1;";
+
+  db->prepareStatement(stmt, query);
+  std::set<std::string> widened = {};
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    widened.insert(db->getStringFromStatement(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  return widened;
+}
+
+std::set<std::string> CallGraph::getWidenedFiles() {
+  sqlite3_stmt *stmt;
+  std::string query = "SELECT DISTINCT filename FROM functions_table WHERE "
+                      "widened = 1 AND filename IS NOT NULL;";
+
+  db->prepareStatement(stmt, query);
+  std::set<std::string> files = {};
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    files.insert(db->getStringFromStatement(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  return files;
+}
+
 void CallGraph::markNodesAsStale(std::string fileName) {
   sqlite3_stmt *stmt;
   std::string query = "UPDATE functions_table SET stale = 1 WHERE filename = ? AND "
@@ -0,0 +1,159 @@
+#include "checkpoints.h"
+#include "metrics.h"
+#include <algorithm>
+
+// the phases of a run in the order the pipeline runs them
+static const std::vector<std::string> phaseOrder = {
+    "parsing", "phase 1", "phase 2", "phase 3",
+    "phase 1 deferred", "phase 3 deferred"};
+
+static int phaseIndex(const std::string &phase) {
+  return std::find(phaseOrder.begin(), phaseOrder.end(), phase) -
+         phaseOrder.begin();
+}
+
+Checkpoints::Checkpoints(Database *db)
+    : db(db), lastCommit(std::chrono::steady_clock::now()){};
+
+bool Checkpoints::hasUnfinishedRun() { return getStoredPhase() != ""; }
+
+void Checkpoints::startRun(const std::vector<std::string> &files) {
+  finishRun();
+  startPhase("parsing", files);
+}
+
+void Checkpoints::finishRun() {
+  sqlite3_stmt *stmt;
+  for (const char *table :
+       {"checkpoint", "checkpoint_items", "checkpoint_functions"}) {
+    std::string query = "DELETE FROM " + std::string(table) + ";";
+    db->prepareStatement(stmt, query);
+    db->runStatement(stmt);
+  }
+}
+
+std::string Checkpoints::getStoredPhase() {
+  sqlite3_stmt *stmt;
+  std::string query = "SELECT phase FROM checkpoint LIMIT 1;";
+  db->prepareStatement(stmt, query);
+  std::string storedPhase = "";
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    storedPhase = db->getStringFromStatement(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  return storedPhase;
+}
+
+bool Checkpoints::isPhaseFinished(const std::string &phase) {
+  std::string storedPhase = getStoredPhase();
+  return storedPhase != "" && phaseIndex(phase) < phaseIndex(storedPhase);
+}
+
+bool Checkpoints::resumePhase(const std::string &phase,
+                              std::vector<std::string> &items) {
+  if (getStoredPhase() != phase) {
+    return false;
+  }
+  sqlite3_stmt *stmt;
+  std::string query = "SELECT position FROM checkpoint LIMIT 1;";
+  db->prepareStatement(stmt, query);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    position = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+
+  query = "SELECT item FROM checkpoint_items ORDER BY position;";
+  db->prepareStatement(stmt, query);
+  items = {};
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    items.push_back(db->getStringFromStatement(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+
+  this->phase = phase;
+  lastCommit = std::chrono::steady_clock::now();
+  return true;
+}
+
+void Checkpoints::startPhase(const std::string &phase,
+                             const std::vector<std::string> &items) {
+  sqlite3_stmt *stmt;
+  std::string query = "DELETE FROM checkpoint_items;";
+  db->prepareStatement(stmt, query);
+  db->runStatement(stmt);
+
+  query = "INSERT INTO checkpoint_items (position, item) VALUES (?, ?);";
+  for (size_t i = 0; i < items.size(); i++) {
+    std::vector<std::string> params = {std::to_string(i), items[i]};
+    db->prepareStatement(stmt, query, params);
+    db->runStatement(stmt);
+  }
+
+  this->phase = phase;
+  position = 0;
+  query = "DELETE FROM checkpoint;";
+  db->prepareStatement(stmt, query);
+  db->runStatement(stmt);
+
+  query = "INSERT INTO checkpoint (phase, position) VALUES (?, 0);";
+  std::vector<std::string> params = {phase};
+  db->prepareStatement(stmt, query, params);
+  db->runStatement(stmt);
+  lastCommit = std::chrono::steady_clock::now();
+}
+
+int Checkpoints::getPosition() { return position; }
+
+void Checkpoints::itemFinished(int position) {
+  this->position = position;
+  auto now = std::chrono::steady_clock::now();
+  if (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastCommit)
+          .count() < intervalMs) {
+    return;
+  }
+  savePosition();
+  db->commitTransaction();
+  db->beginTransaction(phase);
+  metricCount("checkpoints_committed", 1);
+  lastCommit = now;
+}
+
+void Checkpoints::finishPhase() { savePosition(); }
+
+void Checkpoints::setInterval(long long intervalMs) {
+  this->intervalMs = intervalMs;
+}
+
+void Checkpoints::savePosition() {
+  sqlite3_stmt *stmt;
+  std::string query = "UPDATE checkpoint SET position = ?;";
+  std::vector<std::string> params = {std::to_string(position)};
+  db->prepareStatement(stmt, query, params);
+  db->runStatement(stmt);
+}
+
+void Checkpoints::addFunctions(const std::string &kind,
+                               const std::vector<std::string> &functions) {
+  sqlite3_stmt *stmt;
+  std::string query =
+      "INSERT INTO checkpoint_functions (kind, funcname) VALUES (?, ?);";
+  for (const std::string &funcName : functions) {
+    std::vector<std::string> params = {kind, funcName};
+    db->prepareStatement(stmt, query, params);
+    db->runStatement(stmt);
+  }
+}
+
+std::vector<std::string> Checkpoints::getFunctions(const std::string &kind) {
+  sqlite3_stmt *stmt;
+  std::string query = "SELECT funcname FROM checkpoint_functions WHERE kind = "
+                      "? ORDER BY rowid;";
+  std::vector<std::string> params = {kind};
+  db->prepareStatement(stmt, query, params);
+  std::vector<std::string> functions;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    functions.push_back(db->getStringFromStatement(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  return functions;
+}
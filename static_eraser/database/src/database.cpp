@@ -1,4 +1,9 @@
 #include "database.h"
+#include "analysis_version.h"
+#include "metrics.h"
+#include "sql_profiler.h"
+#include "trace.h"
+#include <cctype>
 
 const std::string Database::dbName = "eraser.db";
 
@@ -9,6 +14,8 @@ void Database::prepareStatement(sqlite3_stmt *&stmt, std::string query,
               << std::endl;
     return;
   }
+  statementCount++;
+  metricCount("sql_statements_prepared", 1);
   for (int i = 0; i < params.size(); i++) {
     if (sqlite3_bind_text(stmt, i + 1, params[i].c_str(), -1, SQLITE_STATIC) !=
         SQLITE_OK) {
@@ -23,22 +30,80 @@ void Database::prepareStatement(sqlite3_stmt *&stmt, std::string query) {
   if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
     std::cerr << "Error preparing statement: " << sqlite3_errmsg(db)
               << std::endl;
+    return;
+  }
+  statementCount++;
+  metricCount("sql_statements_prepared", 1);
+}
+
+// the first words of a statement, used to name its trace span
+static std::string statementSummary(const char *sql) {
+  std::string summary;
+  for (const char *c = sql; *c != '\0' && summary.size() < 48; c++) {
+    if (std::isspace((unsigned char)*c)) {
+      if (!summary.empty() && summary.back() != ' ') {
+        summary += ' ';
+      }
+    } else {
+      summary += *c;
+    }
   }
+  return summary;
 }
 
 void Database::runStatement(sqlite3_stmt *stmt) {
+  std::string sql;
+  if (Tracer::instance().isEnabled()) {
+    sql = sqlite3_sql(stmt);
+  }
+  TraceSpan span("sql", statementSummary(sql.c_str()), sql);
   if (sqlite3_step(stmt) != SQLITE_DONE) {
     std::cerr << "Error running statement: " << sqlite3_errmsg(db) << std::endl;
+  } else {
+    metricCount("sql_rows_written", sqlite3_changes(db));
   }
+  metricCount("sql_statements_run", 1);
   sqlite3_finalize(stmt);
 }
 
+void Database::beginTransaction(std::string name) {
+  if (transactionDepth++ > 0) {
+    return;
+  }
+  if (sqlite3_exec(db, "BEGIN;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+    std::cerr << "Error beginning transaction: " << errMsg << std::endl;
+    sqlite3_free(errMsg);
+  }
+  transactionName = name;
+  if (Tracer::instance().isEnabled()) {
+    transactionStart = Tracer::instance().now();
+  }
+}
+
+void Database::commitTransaction() {
+  if (transactionDepth == 0 || --transactionDepth > 0) {
+    return;
+  }
+  if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &errMsg) != SQLITE_OK) {
+    std::cerr << "Error committing transaction: " << errMsg << std::endl;
+    sqlite3_free(errMsg);
+  }
+  Tracer &tracer = Tracer::instance();
+  if (tracer.isEnabled()) {
+    tracer.addSpan("transaction", transactionName, "", transactionStart,
+                   tracer.now() - transactionStart);
+  }
+}
+
 void Database::deleteDatabase() {
-  if (std::remove(dbName.c_str()) == 0) {
-    std::cout << "Database file \"" << dbName << "\" deleted successfully"
+  // a stale write-ahead log must not be replayed into the new database
+  std::remove((dbPath + "-wal").c_str());
+  std::remove((dbPath + "-shm").c_str());
+  if (std::remove(dbPath.c_str()) == 0) {
+    std::cout << "Database file \"" << dbPath << "\" deleted successfully"
               << std::endl;
   } else {
-    std::cout << "Database file \"" << dbName
+    std::cout << "Database file \"" << dbPath
               << "\" does not exist or could not be deleted." << std::endl;
   }
 }
@@ -53,11 +118,51 @@ void Database::createTable(std::string query, std::string tableName) {
 void Database::createTables() {
   createTable(R"(
     CREATE TABLE eraser_settings (
-      prev_hash TEXT
+      prev_hash TEXT,
+      analysis_version INTEGER
     )
   )",
               "eraser_settings");
 
+  // the only row of settings, later runs update it in place
+  sqlite3_stmt *stmt;
+  std::vector<std::string> params = {std::to_string(analysisVersion)};
+  prepareStatement(stmt,
+                   "INSERT INTO eraser_settings (analysis_version) VALUES (?);",
+                   params);
+  runStatement(stmt);
+
+  createTable(R"(
+    CREATE TABLE checkpoint (
+      phase TEXT,
+      position INTEGER
+    )
+  )",
+              "checkpoint");
+
+  createTable(R"(
+    CREATE TABLE checkpoint_items (
+      position INTEGER PRIMARY KEY,
+      item TEXT
+    )
+  )",
+              "checkpoint_items");
+
+  createTable(R"(
+    CREATE TABLE checkpoint_functions (
+      kind TEXT CHECK(kind IN ('changed', 'deferred')),
+      funcname TEXT
+    )
+  )",
+              "checkpoint_functions");
+
+  createTable(R"(
+    CREATE TABLE roots (
+      funcname TEXT PRIMARY KEY
+    )
+  )",
+              "roots");
+
   createTable(R"(
     CREATE TABLE file_includes (
       filename TEXT,
@@ -74,7 +179,8 @@ void Database::createTables() {
       marked BOOLEAN DEFAULT FALSE,
       recently_changed BOOLEAN DEFAULT TRUE,
       filename TEXT DEFAULT NULL,
-      stale BOOLEAN DEFAULT FALSE
+      stale BOOLEAN DEFAULT FALSE,
+      widened BOOLEAN DEFAULT FALSE
     );
   )",
               "functions_table");
@@ -219,17 +325,62 @@ void Database::createTables() {
    )",
               "function_variable_locksets_callers_locks");
 
+  createTable(R"(
+    CREATE TABLE locksets (
+      id INTEGER PRIMARY KEY,
+      locks TEXT UNIQUE
+    );
+  )",
+              "locksets");
+
   createTable(R"(
     CREATE TABLE function_variable_locksets_outputs (
       function_variable_locksets_id INTEGER,
       varname TEXT,
-      lock TEXT,
+      lockset_id INTEGER,
       FOREIGN KEY (function_variable_locksets_id) REFERENCES function_variable_locksets(id) ON DELETE CASCADE,
-      UNIQUE(function_variable_locksets_id, varname, lock)
+      FOREIGN KEY (lockset_id) REFERENCES locksets(id),
+      UNIQUE(function_variable_locksets_id, varname)
     );
   )",
               "function_variable_locksets_outputs");
 
+  createTable(R"(
+    CREATE TABLE variable_locksets_memo (
+      id INTEGER PRIMARY KEY,
+      funcname TEXT,
+      cfg_hash TEXT,
+      input_lockset_id INTEGER,
+      FOREIGN KEY (input_lockset_id) REFERENCES locksets(id),
+      UNIQUE(funcname, cfg_hash, input_lockset_id)
+    );
+  )",
+              "variable_locksets_memo");
+
+  createTable(R"(
+    CREATE TABLE variable_locksets_memo_outputs (
+      memo_id INTEGER,
+      varname TEXT,
+      lockset_id INTEGER,
+      FOREIGN KEY (memo_id) REFERENCES variable_locksets_memo(id) ON DELETE CASCADE,
+      FOREIGN KEY (lockset_id) REFERENCES locksets(id),
+      UNIQUE(memo_id, varname)
+    );
+  )",
+              "variable_locksets_memo_outputs");
+
+  createTable(R"(
+    CREATE TABLE variable_locksets_memo_calls (
+      memo_id INTEGER,
+      callee TEXT,
+      lockset_id INTEGER,
+      FOREIGN KEY (memo_id) REFERENCES variable_locksets_memo(id) ON DELETE CASCADE,
+      FOREIGN KEY (lockset_id) REFERENCES locksets(id),
+      UNIQUE(memo_id, callee)
+    );
+  )",
+              "variable_locksets_memo_calls");
+
   createTable(R"(
     CREATE TABLE function_variable_direct_accesses (
       funcname TEXT,
@@ -257,9 +408,10 @@ void Database::createTables() {
     CREATE TABLE function_cumulative_locksets_outputs (
       function_cumulative_locksets_id INTEGER,
       varname TEXT,
-      lock TEXT,
+      lockset_id INTEGER,
       FOREIGN KEY (function_cumulative_locksets_id) REFERENCES function_cumulative_locksets(id) ON DELETE CASCADE,
-      UNIQUE(function_cumulative_locksets_id, varname, lock)
+      FOREIGN KEY (lockset_id) REFERENCES locksets(id),
+      UNIQUE(function_cumulative_locksets_id, varname)
     );
   )",
               "function_cumulative_locksets_outputs");
@@ -276,12 +428,12 @@ void Database::createTables() {
               "function_cumulative_accesses");
 }
 
-Database::Database(bool initialCommit) {
+Database::Database(bool initialCommit, std::string dbPath) : dbPath(dbPath) {
   if (initialCommit) {
     deleteDatabase();
   }
 
-  if (sqlite3_open(dbName.c_str(), &db) != SQLITE_OK) {
+  if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
     std::cerr << "Error opening database: " << sqlite3_errmsg(db) << std::endl;
     return;
   }
@@ -293,10 +445,11 @@ Database::Database(bool initialCommit) {
   sqlite3_exec(db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
   // sqlite3_exec(db, "PRAGMA cache_size = -100000;", nullptr, nullptr,
   // nullptr); sqlite3_exec(db, "PRAGMA mmap_size = 268435456;", nullptr,
-  // nullptr, nullptr); sqlite3_exec(db, "PRAGMA synchronous = NORMAL;",
-  // nullptr, nullptr, nullptr);
-  // sqlite3_exec(db, "PRAGMA journal_mode = WAL;", nullptr, nullptr, nullptr);
-  sqlite3_exec(db, "PRAGMA journal_mode = OFF;", nullptr, nullptr, nullptr);
+  // nullptr, nullptr);
+  // commits are atomic so that an interrupted run leaves the database as of
+  // its last commit, NORMAL only syncs when the log is copied into the database
+  sqlite3_exec(db, "PRAGMA journal_mode = WAL;", nullptr, nullptr, nullptr);
+  sqlite3_exec(db, "PRAGMA synchronous = NORMAL;", nullptr, nullptr, nullptr);
 }
 
 std::string Database::createTupleList(std::vector<std::string> &nodes) {
@@ -320,6 +473,8 @@ std::string Database::createBoolean(bool value) {
 
 bool Database::retrieveBoolean(std::string value) { return value == "1"; }
 
+long long Database::getStatementCount() { return statementCount; }
+
 std::string Database::getStringFromStatement(sqlite3_stmt *stmt, int col) {
   std::string result = "";
   const char *text =
@@ -330,4 +485,17 @@ std::string Database::getStringFromStatement(sqlite3_stmt *stmt, int col) {
   return result;
 }
 
-Database::~Database() { sqlite3_close(db); }
\ No newline at end of file
+void Database::enableProfiling() {
+  if (profiler == nullptr) {
+    profiler = new SqlProfiler(db);
+  }
+}
+
+SqlProfiler *Database::getProfiler() { return profiler; }
+
+std::string Database::getPath() { return dbPath; }
+
+Database::~Database() {
+  delete profiler;
+  sqlite3_close(db);
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "database_maintenance.h"
+#include "metrics.h"
+#include <filesystem>
+#include <iomanip>
+
+DatabaseMaintenance::DatabaseMaintenance(Database *db) : db(db){};
+
+long long DatabaseMaintenance::getPragma(const std::string &pragma) {
+  sqlite3_stmt *stmt;
+  db->prepareStatement(stmt, "PRAGMA " + pragma + ";");
+  long long value = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    value = sqlite3_column_int64(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  return value;
+}
+
+long long DatabaseMaintenance::getSizeBytes() {
+  return getPragma("page_count") * getPragma("page_size");
+}
+
+double DatabaseMaintenance::getFreeFraction() {
+  long long pages = getPragma("page_count");
+  if (pages == 0) {
+    return 0;
+  }
+  return (double)getPragma("freelist_count") / pages;
+}
+
+std::vector<std::string> DatabaseMaintenance::getTables() {
+  sqlite3_stmt *stmt;
+  db->prepareStatement(stmt, "SELECT name FROM sqlite_master WHERE type = "
+                             "'table' AND name NOT LIKE 'sqlite_%';");
+  std::vector<std::string> tables;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    tables.push_back(db->getStringFromStatement(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  return tables;
+}
+
+long long DatabaseMaintenance::countRows(const std::string &table) {
+  sqlite3_stmt *stmt;
+  db->prepareStatement(stmt, "SELECT COUNT(*) FROM " + table + ";");
+  long long rows = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    rows = sqlite3_column_int64(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  return rows;
+}
+
+void DatabaseMaintenance::runQuery(const std::string &query,
+                                   std::vector<std::string> params) {
+  sqlite3_stmt *stmt;
+  db->prepareStatement(stmt, query, params);
+  db->runStatement(stmt);
+}
+
+// files the database knows about that are no longer on disk, paths are
+// relative to the directory the analysis runs in, so nothing is reported
+// missing when none of them can be found from here
+std::vector<std::string> DatabaseMaintenance::getMissingFiles() {
+  sqlite3_stmt *stmt;
+  db->prepareStatement(
+      stmt, "SELECT filename FROM functions_table WHERE filename IS NOT NULL "
+            "UNION SELECT filename FROM file_includes "
+            "UNION SELECT included_file FROM file_includes;");
+  std::vector<std::string> missing;
+  bool anyFound = false;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    std::string fileName = db->getStringFromStatement(stmt, 0);
+    if (std::filesystem::exists(fileName)) {
+      anyFound = true;
+    } else {
+      missing.push_back(fileName);
+    }
+  }
+  sqlite3_finalize(stmt);
+  if (!anyFound) {
+    return {};
+  }
+  return missing;
+}
+
+void DatabaseMaintenance::deleteOrphans() {
+  std::vector<std::string> missing = getMissingFiles();
+  missingFiles = missing.size();
+  std::string missingList = db->createTupleList(missing);
+
+  // functions nothing calls that are only known from calls or were defined in
+  // deleted files, deleting one can leave its callees uncalled
+  long long functions = countRows("functions_table");
+  while (true) {
+    runQuery("DELETE FROM functions_table WHERE (filename IS NULL OR "
+             "filename IN " +
+                 missingList +
+                 ") AND funcname NOT IN (SELECT callee FROM function_calls) "
+                 "AND funcname NOT IN (SELECT funcname FROM roots);",
+             missing);
+    long long remaining = countRows("functions_table");
+    if (remaining == functions) {
+      break;
+    }
+    functions = remaining;
+  }
+
+  std::vector<std::string> params = missing;
+  params.insert(params.end(), missing.begin(), missing.end());
+  runQuery("DELETE FROM file_includes WHERE filename IN " + missingList +
+               " OR included_file IN " + missingList + ";",
+           params);
+
+  runQuery("DELETE FROM function_recursive_unlocks WHERE funcname NOT IN "
+           "(SELECT funcname FROM functions_table);");
+  runQuery("DELETE FROM function_variable_locksets_callers WHERE caller NOT "
+           "IN (SELECT funcname FROM functions_table);");
+  runQuery("DELETE FROM variable_locksets_memo WHERE funcname NOT IN "
+           "(SELECT funcname FROM functions_table);");
+
+  // results of tests that no longer reach a function
+  sqlite3_stmt *stmt;
+  db->prepareStatement(stmt, "SELECT funcname FROM roots;");
+  std::vector<std::string> roots;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    roots.push_back(db->getStringFromStatement(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  for (std::string table :
+       {"function_variable_locksets", "function_cumulative_locksets"}) {
+    runQuery("DELETE FROM " + table +
+             " WHERE testname NOT IN (SELECT funcname FROM roots);");
+    for (const std::string &root : roots) {
+      runQuery("WITH RECURSIVE reachable(funcname) AS (SELECT ? UNION "
+               "SELECT function_calls.callee FROM function_calls JOIN "
+               "reachable ON function_calls.caller = reachable.funcname) "
+               "DELETE FROM " +
+                   table +
+                   " WHERE testname = ? AND funcname NOT IN (SELECT funcname "
+                   "FROM reachable);",
+               {root, root});
+    }
+  }
+
+  runQuery("DELETE FROM locksets WHERE id NOT IN ("
+           "SELECT lockset_id FROM function_variable_locksets_outputs "
+           "UNION SELECT lockset_id FROM function_cumulative_locksets_outputs "
+           "UNION SELECT input_lockset_id FROM variable_locksets_memo "
+           "UNION SELECT lockset_id FROM variable_locksets_memo_outputs "
+           "UNION SELECT lockset_id FROM variable_locksets_memo_calls);");
+}
+
+void DatabaseMaintenance::collectGarbage() {
+  metricTimer("gc_ms");
+  bytesBefore = getSizeBytes();
+  std::map<std::string, long long> rowsBefore;
+  for (const std::string &table : getTables()) {
+    rowsBefore[table] = countRows(table);
+  }
+
+  db->beginTransaction("collect garbage");
+  deleteOrphans();
+  db->commitTransaction();
+
+  rowsDeleted = {};
+  for (const auto &pair : rowsBefore) {
+    long long deleted = pair.second - countRows(pair.first);
+    if (deleted > 0) {
+      rowsDeleted[pair.first] = deleted;
+      metricCount("gc_rows_deleted", deleted);
+    }
+  }
+
+  // VACUUM cannot run inside a transaction
+  runQuery("REINDEX;");
+  runQuery("ANALYZE;");
+  runQuery("VACUUM;");
+  bytesAfter = getSizeBytes();
+}
+
+void DatabaseMaintenance::printReport(std::ostream &stream) {
+  long long totalRows = 0;
+  for (const auto &pair : rowsDeleted) {
+    totalRows += pair.second;
+  }
+  stream << "Garbage collection: " << totalRows << " rows deleted, "
+         << std::fixed << std::setprecision(1) << bytesBefore / 1024.0
+         << " KB -> " << bytesAfter / 1024.0 << " KB, "
+         << (bytesBefore - bytesAfter) / 1024.0 << " KB reclaimed"
+         << std::endl;
+  for (const auto &pair : rowsDeleted) {
+    stream << "  " << pair.first << ": " << pair.second << std::endl;
+  }
+  if (missingFiles > 0) {
+    stream << "  files no longer on disk: " << missingFiles << std::endl;
+  }
+}
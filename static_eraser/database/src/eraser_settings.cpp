@@ -1,8 +1,9 @@
 #include "eraser_settings.h"
+#include "analysis_version.h"
 
 EraserSettings::EraserSettings(Database *db) : db(db){};
 
-std::string EraserSettings::getAndUpdatePrevHash(std::string commitHash) {
+std::string EraserSettings::getPrevHash() {
   sqlite3_stmt *stmt;
   std::string query = "SELECT prev_hash FROM eraser_settings LIMIT 1;";
 
@@ -12,15 +13,39 @@ std::string EraserSettings::getAndUpdatePrevHash(std::string commitHash) {
     prevHash = db->getStringFromStatement(stmt, 0);
   }
   sqlite3_finalize(stmt);
+  return prevHash;
+}
 
-  query = "DELETE FROM eraser_settings";
-  db->prepareStatement(stmt, query);
-  db->runStatement(stmt);
-
-  query = "INSERT INTO eraser_settings (prev_hash) VALUES (?);";
+void EraserSettings::setPrevHash(std::string commitHash) {
+  sqlite3_stmt *stmt;
+  std::string query = "UPDATE eraser_settings SET prev_hash = ?;";
   std::vector<std::string> params = {commitHash};
   db->prepareStatement(stmt, query, params);
   db->runStatement(stmt);
+}
 
-  return prevHash;
-}
\ No newline at end of file
+int EraserSettings::getAnalysisVersion() {
+  // older databases have no such column, and a query naming it would fail
+  sqlite3_stmt *stmt;
+  std::string query = "SELECT 1 FROM pragma_table_info('eraser_settings') "
+                      "WHERE name = 'analysis_version';";
+  db->prepareStatement(stmt, query);
+  bool recorded = sqlite3_step(stmt) == SQLITE_ROW;
+  sqlite3_finalize(stmt);
+  if (!recorded) {
+    return 0;
+  }
+
+  query = "SELECT analysis_version FROM eraser_settings LIMIT 1;";
+  db->prepareStatement(stmt, query);
+  int version = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    version = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  return version;
+}
+
+bool EraserSettings::hasCurrentAnalysisVersion() {
+  return getAnalysisVersion() == analysisVersion;
+}
@@ -2,7 +2,8 @@
 
 FunctionCumulativeLocksets::FunctionCumulativeLocksets(
     Database *db, FunctionVariableLocksets *functionVariableLocksets)
-    : db(db), functionVariableLocksets(functionVariableLocksets){};
+    : db(db), functionVariableLocksets(functionVariableLocksets),
+      locksetTable(functionVariableLocksets->getLocksetTable()){};
 
 bool FunctionCumulativeLocksets::shouldVisitNode(std::string funcName) {
   sqlite3_stmt *stmt;
@@ -42,6 +43,7 @@ std::set<std::string> FunctionCumulativeLocksets::getFunctionCumulativeAccesses(
     std::string varName = db->getStringFromStatement(stmt, 0);
     variableAccesses.insert(varName);
   }
+  sqlite3_finalize(stmt);
   return variableAccesses;
 }
 
@@ -54,10 +56,12 @@ TestVariableLocks FunctionCumulativeLocksets::getFunctionCumulativeLocksets(
   std::vector<std::string> params = {funcName};
   db->prepareStatement(stmt, query, params);
   VariableLocks defaultVariableLocks = {};
+  LocksetId emptyId = locksetTable->getEmpty();
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     std::string varName = db->getStringFromStatement(stmt, 0);
-    defaultVariableLocks.insert({varName, {}});
+    defaultVariableLocks.insert({varName, emptyId});
   }
+  sqlite3_finalize(stmt);
 
   query =
       "SELECT id, testname FROM function_cumulative_locksets WHERE "
@@ -76,15 +80,15 @@ TestVariableLocks FunctionCumulativeLocksets::getFunctionCumulativeLocksets(
   sqlite3_finalize(stmt);
 
   query =
-      "SELECT varname, lock FROM function_cumulative_locksets_outputs "
+      "SELECT varname, lockset_id FROM function_cumulative_locksets_outputs "
       "WHERE function_cumulative_locksets_id = ?;";
   for (int i = 0; i < ids.size(); i++) {
     params = {ids[i]};
     db->prepareStatement(stmt, query, params);
     while (sqlite3_step(stmt) == SQLITE_ROW) {
       std::string varName = db->getStringFromStatement(stmt, 0);
-      std::string lock = db->getStringFromStatement(stmt, 1);
-      cumulativeLocksets[testNames[i]][varName].insert(lock);
+      cumulativeLocksets[testNames[i]][varName] =
+          sqlite3_column_int64(stmt, 1);
     }
     sqlite3_finalize(stmt);
   }
@@ -132,6 +136,7 @@ FunctionCumulativeLocksets::computeFunctionCumulativeAccesses(
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     cumulativeAccesses.insert(db->getStringFromStatement(stmt, 0));
   }
+  sqlite3_finalize(stmt);
   return cumulativeAccesses;
 }
 
@@ -150,17 +155,41 @@ TestVariableLocks FunctionCumulativeLocksets::computeFunctionCumulativeLocksets(
     testVariableLocks.insert(
         {testName, functionVariableLocksets->getVariableLocks(funcName, id)});
   }
+  sqlite3_finalize(stmt);
 
   query = "SELECT callee FROM function_calls WHERE caller = ?;";
   params = {funcName};
   db->prepareStatement(stmt, query, params);
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     std::string callee = db->getStringFromStatement(stmt, 0);
-    testVariableLocks *= getFunctionCumulativeLocksets(callee);
+    intersectTestVariableLocks(testVariableLocks,
+                               getFunctionCumulativeLocksets(callee));
   }
+  sqlite3_finalize(stmt);
   return testVariableLocks;
 }
 
+void FunctionCumulativeLocksets::intersectTestVariableLocks(
+    TestVariableLocks &testVariableLocks, const TestVariableLocks &other) {
+  for (auto it = testVariableLocks.begin(); it != testVariableLocks.end();) {
+    auto otherTest = other.find(it->first);
+    if (otherTest == other.end()) {
+      it = testVariableLocks.erase(it);
+      continue;
+    }
+    VariableLocks &variableLocks = it->second;
+    for (const auto &pair : otherTest->second) {
+      auto variable = variableLocks.find(pair.first);
+      if (variable != variableLocks.end()) {
+        variable->second = locksetTable->intersect(variable->second, pair.second);
+      } else {
+        variableLocks.insert(pair);
+      }
+    }
+    ++it;
+  }
+}
+
 FunctionCumulativeData
 FunctionCumulativeLocksets::computeFunctionCumulativeData(
     std::string funcName) {
@@ -201,6 +230,11 @@ void FunctionCumulativeLocksets::insertFunctionCumulativeData(
 
   query = "SELECT id FROM function_cumulative_locksets WHERE "
           "funcname = ? AND testname = ?;";
+  std::string outputsQuery =
+      "INSERT INTO function_cumulative_locksets_outputs "
+      "(function_cumulative_locksets_id, varname, lockset_id) "
+      "VALUES (?, ?, ?);";
+  LocksetId emptyId = locksetTable->getEmpty();
   for (const auto &pair : testVariableLocks) {
     params = {funcName, pair.first};
     db->prepareStatement(stmt, query, params);
@@ -210,15 +244,14 @@ void FunctionCumulativeLocksets::insertFunctionCumulativeData(
     }
     sqlite3_finalize(stmt);
 
-    query = "INSERT INTO function_cumulative_locksets_outputs "
-            "(function_cumulative_locksets_id, varname, lock) "
-            "VALUES (?, ?, ?);";
+    // variables without an output row hold the empty lockset
     for (const auto &pair2 : pair.second) {
-      for (const std::string &lock : pair2.second) {
-        params = {id, pair2.first, lock};
-        db->prepareStatement(stmt, query, params);
-        db->runStatement(stmt);
+      if (pair2.second == emptyId) {
+        continue;
       }
+      params = {id, pair2.first, std::to_string(pair2.second)};
+      db->prepareStatement(stmt, outputsQuery, params);
+      db->runStatement(stmt);
     }
   }
 
@@ -231,7 +264,8 @@ void FunctionCumulativeLocksets::insertFunctionCumulativeData(
   }
 }
 
-void FunctionCumulativeLocksets::updateFunctionCumulativeLocksets(
+FunctionCumulativeData
+FunctionCumulativeLocksets::updateFunctionCumulativeLocksets(
     std::string funcName) {
   FunctionCumulativeData originalCumulativeData =
       getFunctionCumulativeData(funcName);
@@ -242,6 +276,7 @@ void FunctionCumulativeLocksets::updateFunctionCumulativeLocksets(
     deleteFunctionCumulativeData(funcName);
     insertFunctionCumulativeData(funcName, newCumulativeData);
   }
+  return newCumulativeData;
 }
 
 std::vector<std::string> FunctionCumulativeLocksets::getFunctionsForTesting() {
@@ -254,26 +289,37 @@ std::vector<std::string> FunctionCumulativeLocksets::getFunctionsForTesting() {
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     functions.push_back(db->getStringFromStatement(stmt, 0));
   }
+  sqlite3_finalize(stmt);
   return functions;
 }
 
-std::set<std::string> FunctionCumulativeLocksets::detectDataRaces() {
-  std::string funcName = "main";
-  std::string testName = "debug";
-
-  VariableLocks mainLocksets =
-      getFunctionCumulativeLocksets(funcName)[testName];
-
-  std::set<std::string> dataRaces = {};
+std::set<std::string>
+FunctionCumulativeLocksets::getSharedModifiedVariables(std::string funcName) {
+  std::set<std::string> variables = {};
   sqlite3_stmt *stmt;
   std::string query = "SELECT varname FROM function_vars WHERE funcname = ? "
                       "AND type = 'shared_modified';";
   std::vector<std::string> params = {funcName};
   db->prepareStatement(stmt, query, params);
   while (sqlite3_step(stmt) == SQLITE_ROW) {
-    std::string varName = db->getStringFromStatement(stmt, 0);
-    if (mainLocksets.find(varName) == mainLocksets.end() ||
-        mainLocksets[varName].empty()) {
+    variables.insert(db->getStringFromStatement(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  return variables;
+}
+
+std::set<std::string>
+FunctionCumulativeLocksets::detectDataRaces(std::string root) {
+  std::string funcName = root;
+  std::string testName = root;
+
+  VariableLocks rootLocksets =
+      getFunctionCumulativeLocksets(funcName)[testName];
+
+  std::set<std::string> dataRaces = {};
+  for (const std::string &varName : getSharedModifiedVariables(funcName)) {
+    if (rootLocksets.find(varName) == rootLocksets.end() ||
+        locksetTable->get(rootLocksets[varName]).empty()) {
       dataRaces.insert(varName);
     }
   }
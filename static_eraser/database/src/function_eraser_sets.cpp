@@ -1,4 +1,15 @@
 #include "function_eraser_sets.h"
+#include "metrics.h"
+
+// function_vars type of each state, in the order they are stored
+static const std::vector<std::pair<VarStateMask, std::string>> varStateTypes = {
+    {VAR_EXTERNAL_READ, "external_read"},
+    {VAR_INTERNAL_READ, "internal_read"},
+    {VAR_EXTERNAL_WRITE, "external_write"},
+    {VAR_INTERNAL_WRITE, "internal_write"},
+    {VAR_INTERNAL_SHARED, "internal_shared"},
+    {VAR_EXTERNAL_SHARED, "external_shared"},
+    {VAR_SHARED_MODIFIED, "shared_modified"}};
 
 FunctionEraserSets::FunctionEraserSets(Database *db) : db(db) {
   functionSets = {};
@@ -8,22 +19,12 @@ FunctionEraserSets::FunctionEraserSets(Database *db) : db(db) {
 void FunctionEraserSets::combineSets(EraserSets &s1, EraserSets &s2) {
   s1.locks *= s2.locks;
   s1.unlocks += s2.unlocks;
-  s1.sharedModified += s2.sharedModified;
-
-  s1.internalShared += s2.internalShared - s1.sharedModified;
-  s1.externalShared += s2.externalShared - s1.sharedModified;
-  std::set<std::string> sOrSm =
-      s1.sharedModified + s1.internalShared + s1.externalShared;
-  s1.externalReads += s2.externalReads;
-  s1.externalReads -= sOrSm;
-  s1.externalWrites += s2.externalWrites;
-  s1.externalWrites -= sOrSm;
-  s1.internalReads += s2.internalReads;
-  s1.internalReads -= sOrSm;
-  s1.internalWrites += s2.internalWrites;
-  s1.internalWrites -= sOrSm;
+  s1.vars.merge(s2.vars, 0,
+                [](VarId, VarStateMask a, VarStateMask b) {
+                  return combineTransition(a, b);
+                });
   s1.queuedWrites += s2.queuedWrites;
-  s1.queuedWrites.removeVars(s1.sharedModified);
+  s1.queuedWrites.removeVarsInState(s1.vars, VAR_SHARED_MODIFIED);
   s1.activeThreads += s2.activeThreads;
   s1.finishedThreads *= s2.finishedThreads;
   s1.eraserIgnoreOn &= s2.eraserIgnoreOn;
@@ -31,17 +32,12 @@ void FunctionEraserSets::combineSets(EraserSets &s1, EraserSets &s2) {
 
 void FunctionEraserSets::combineSetsForRecursiveThreads(EraserSets &s1,
                                                         EraserSets &s2) {
-  s1.sharedModified += s2.sharedModified;
-  s1.externalShared += s2.internalShared + s2.externalShared;
-  // std::set<std::string> sOrSm =
-  //    s1.sharedModified + s1.internalShared + s1.externalShared;
-  std::set<std::string> sOrSm = s1.sharedModified;
-  s1.externalReads += s2.internalReads + s2.externalReads;
-  s1.externalReads -= sOrSm;
-  s1.externalWrites += s2.internalWrites + s2.externalWrites;
-  s1.externalWrites -= sOrSm;
+  s1.vars.merge(s2.vars, 0,
+                [](VarId, VarStateMask a, VarStateMask b) {
+                  return recursiveThreadTransition(a, b);
+                });
   s1.queuedWrites += s2.queuedWrites;
-  s1.queuedWrites.removeVars(s1.sharedModified);
+  s1.queuedWrites.removeVarsInState(s1.vars, VAR_SHARED_MODIFIED);
   s1.activeThreads += s2.activeThreads;
 }
 
@@ -95,64 +91,41 @@ void FunctionEraserSets::insertCurrSetsIntoDb(bool locksChanged,
 
   query =
       "INSERT INTO function_vars (funcname, varname, type) VALUES (?, ?, ?);";
-  for (const std::string &read : currFuncSets.externalReads) {
-    params = {currFunc, read, "external_read"};
-    db->prepareStatement(stmt, query, params);
-    db->runStatement(stmt);
-  }
-  for (const std::string &read : currFuncSets.internalReads) {
-    params = {currFunc, read, "internal_read"};
-    db->prepareStatement(stmt, query, params);
-    db->runStatement(stmt);
-  }
-  for (const std::string &write : currFuncSets.externalWrites) {
-    params = {currFunc, write, "external_write"};
-    db->prepareStatement(stmt, query, params);
-    db->runStatement(stmt);
-  }
-  for (const std::string &write : currFuncSets.internalWrites) {
-    params = {currFunc, write, "internal_write"};
-    db->prepareStatement(stmt, query, params);
-    db->runStatement(stmt);
-  }
-  for (const std::string &shared : currFuncSets.internalShared) {
-    params = {currFunc, shared, "internal_shared"};
-    db->prepareStatement(stmt, query, params);
-    db->runStatement(stmt);
-  }
-  for (const std::string &shared : currFuncSets.externalShared) {
-    params = {currFunc, shared, "external_shared"};
-    db->prepareStatement(stmt, query, params);
-    db->runStatement(stmt);
-  }
-  for (const std::string &shared : currFuncSets.sharedModified) {
-    params = {currFunc, shared, "shared_modified"};
-    db->prepareStatement(stmt, query, params);
-    db->runStatement(stmt);
+  std::vector<VarId> vars =
+      currVarTable.sortByName(currFuncSets.vars.getVars());
+  for (const auto &stateType : varStateTypes) {
+    for (VarId var : vars) {
+      if (currFuncSets.vars.get(var) & stateType.first) {
+        params = {currFunc, currVarTable.getName(var), stateType.second};
+        db->prepareStatement(stmt, query, params);
+        db->runStatement(stmt);
+      }
+    }
   }
 
   query =
       "INSERT INTO queued_writes (funcname, tid, varname) VALUES (?, ?, ?);";
   for (const auto &pair : currFuncSets.queuedWrites) {
-    for (const std::string &write : pair.second) {
-      params = {currFunc, pair.first, write};
+    for (VarId write : currVarTable.sortByName(pair.second)) {
+      params = {currFunc, pair.first, currVarTable.getName(write)};
       db->prepareStatement(stmt, query, params);
       db->runStatement(stmt);
     }
   }
 
   query = "INSERT INTO finished_threads (funcname, varname) VALUES (?, ?);";
-  for (const std::string &thread : currFuncSets.finishedThreads) {
-    params = {currFunc, thread};
+  for (VarId thread : currVarTable.sortByName(currFuncSets.finishedThreads)) {
+    params = {currFunc, currVarTable.getName(thread)};
     db->prepareStatement(stmt, query, params);
     db->runStatement(stmt);
   }
 
   query =
       "INSERT INTO active_threads (funcname, varname, tid) VALUES (?, ?, ?);";
-  for (const auto &pair : currFuncSets.activeThreads) {
-    for (const std::string &tid : pair.second) {
-      params = {currFunc, pair.first, tid};
+  const ActiveThreads &activeThreads = currFuncSets.activeThreads;
+  for (VarId var = 0; var < activeThreads.varEnd(); var++) {
+    for (const std::string &tid : activeThreads.getTids(var)) {
+      params = {currFunc, currVarTable.getName(var), tid};
       db->prepareStatement(stmt, query, params);
       db->runStatement(stmt);
     }
@@ -168,7 +141,8 @@ void FunctionEraserSets::deleteCurrFuncFromDb() {
   db->runStatement(stmt);
 }
 
-EraserSets FunctionEraserSets::extractSetsFromDb(std::string funcName) {
+EraserSets FunctionEraserSets::extractSetsFromDb(std::string funcName,
+                                                 VarTable &varTable) {
   EraserSets sets = EraserSets::defaultValue;
   sqlite3_stmt *stmt;
 
@@ -191,20 +165,10 @@ EraserSets FunctionEraserSets::extractSetsFromDb(std::string funcName) {
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     std::string varName = db->getStringFromStatement(stmt, 1);
     std::string type = db->getStringFromStatement(stmt, 2);
-    if (type == "external_read") {
-      sets.externalReads.insert(varName);
-    } else if (type == "internal_read") {
-      sets.internalReads.insert(varName);
-    } else if (type == "external_write") {
-      sets.externalWrites.insert(varName);
-    } else if (type == "internal_write") {
-      sets.internalWrites.insert(varName);
-    } else if (type == "internal_shared") {
-      sets.internalShared.insert(varName);
-    } else if (type == "external_shared") {
-      sets.externalShared.insert(varName);
-    } else if (type == "shared_modified") {
-      sets.sharedModified.insert(varName);
+    for (const auto &stateType : varStateTypes) {
+      if (type == stateType.second) {
+        sets.vars.add(varTable.intern(varName), stateType.first);
+      }
     }
   }
   sqlite3_finalize(stmt);
@@ -214,11 +178,7 @@ EraserSets FunctionEraserSets::extractSetsFromDb(std::string funcName) {
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     std::string tid = db->getStringFromStatement(stmt, 1);
     std::string varName = db->getStringFromStatement(stmt, 2);
-    if (sets.queuedWrites.find(tid) == sets.queuedWrites.end()) {
-      sets.queuedWrites.insert({tid, {varName}});
-    } else {
-      sets.queuedWrites[tid].insert(varName);
-    }
+    sets.queuedWrites.insert(tid, varTable.intern(varName));
   }
   sqlite3_finalize(stmt);
 
@@ -226,7 +186,7 @@ EraserSets FunctionEraserSets::extractSetsFromDb(std::string funcName) {
   db->prepareStatement(stmt, query, params);
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     std::string varName = db->getStringFromStatement(stmt, 1);
-    sets.finishedThreads.insert(varName);
+    sets.finishedThreads.insert(varTable.intern(varName));
   }
   sqlite3_finalize(stmt);
 
@@ -235,28 +195,63 @@ EraserSets FunctionEraserSets::extractSetsFromDb(std::string funcName) {
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     std::string varName = db->getStringFromStatement(stmt, 1);
     std::string tid = db->getStringFromStatement(stmt, 2);
-    if (sets.activeThreads.find(varName) == sets.activeThreads.end()) {
-      sets.activeThreads.insert({varName, {tid}});
-    } else {
-      sets.activeThreads[varName].insert(tid);
-    }
+    sets.activeThreads.insert(varTable.intern(varName), tid);
   }
   sqlite3_finalize(stmt);
 
   return sets;
 }
 
-EraserSets *FunctionEraserSets::getEraserSets(std::string funcName) {
-  if (funcName == currFunc) {
-    return &currFuncSets;
+const InternedEraserSets &
+FunctionEraserSets::getInternedSets(std::string funcName) {
+  auto it = functionSets.find(funcName);
+  if (it != functionSets.end()) {
+    metricCount("eraser_sets_cache_hits", 1);
+    return it->second;
+  }
+  metricCount("eraser_sets_cache_misses", 1);
+  InternedEraserSets &interned = functionSets[funcName];
+  interned.sets = extractSetsFromDb(funcName, interned.varTable);
+  return interned;
+}
+
+EraserSets FunctionEraserSets::getEraserSets(std::string funcName,
+                                             VarTable &varTable) {
+  const InternedEraserSets &interned = getInternedSets(funcName);
+  const VarTable &from = interned.varTable;
+  std::vector<VarId> ids;
+  for (VarId var = 0; var < from.size(); var++) {
+    ids.push_back(varTable.intern(from.getName(var)));
+  }
+
+  EraserSets sets = EraserSets::defaultValue;
+  sets.locks = interned.sets.locks;
+  sets.unlocks = interned.sets.unlocks;
+  for (VarId var : interned.sets.vars.getVars()) {
+    sets.vars.set(ids[var], interned.sets.vars.get(var));
   }
-  if (functionSets.find(funcName) != functionSets.end()) {
-    return &functionSets[funcName];
+  for (const auto &pair : interned.sets.queuedWrites) {
+    for (VarId write : pair.second) {
+      sets.queuedWrites.insert(pair.first, ids[write]);
+    }
+  }
+  for (VarId thread : interned.sets.finishedThreads) {
+    sets.finishedThreads.insert(ids[thread]);
   }
-  functionSets.insert({funcName, extractSetsFromDb(funcName)});
-  return &functionSets[funcName];
+  const ActiveThreads &activeThreads = interned.sets.activeThreads;
+  for (VarId var = 0; var < activeThreads.varEnd(); var++) {
+    for (const std::string &tid : activeThreads.getTids(var)) {
+      sets.activeThreads.insert(ids[var], tid);
+    }
+  }
+  sets.eraserIgnoreOn = interned.sets.eraserIgnoreOn;
+  return sets;
 }
 
+EraserSets *FunctionEraserSets::getCurrEraserSets() { return &currFuncSets; }
+
+VarTable &FunctionEraserSets::getCurrVarTable() { return currVarTable; }
+
 void FunctionEraserSets::updateCurrEraserSets(EraserSets &sets) {
   if (currFuncSetsStarted) {
     combineSets(currFuncSets, sets);
@@ -267,12 +262,15 @@ void FunctionEraserSets::updateCurrEraserSets(EraserSets &sets) {
 }
 
 void FunctionEraserSets::saveCurrEraserSets() {
-  functionSets[currFunc] = currFuncSets;
+  functionSets[currFunc] = {currVarTable, currFuncSets};
   bool alreadyInDb = checkCurrFuncInDb();
   if (!alreadyInDb) {
     insertCurrSetsIntoDb(true, true);
   } else {
-    EraserSets originalSets = extractSetsFromDb(currFunc);
+    // a copy of the table gives the stored variables the ids of the current
+    // sets, so that the two can be compared
+    VarTable varTable = currVarTable;
+    EraserSets originalSets = extractSetsFromDb(currFunc, varTable);
     bool locksDiff = !originalSets.locksEqual(currFuncSets);
     bool varsDiff = !originalSets.varsEqual(currFuncSets);
     if (locksDiff || varsDiff) {
@@ -284,10 +282,17 @@ void FunctionEraserSets::saveCurrEraserSets() {
 
 void FunctionEraserSets::startNewFunction(std::string funcName) {
   currFunc = funcName;
+  currVarTable = {};
+  resetCurrEraserSets();
+}
+
+void FunctionEraserSets::resetCurrEraserSets() {
   currFuncSets = EraserSets::defaultValue;
   currFuncSetsStarted = false;
 }
 
+void FunctionEraserSets::clearCache() { functionSets = {}; }
+
 void FunctionEraserSets::markFunctionEraserSetsAsOld() {
   sqlite3_stmt *stmt;
   std::string query =
@@ -301,7 +306,7 @@ void FunctionEraserSets::markFunctionEraserSetsAsOld() {
 }
 
 void FunctionEraserSets::saveFunctionDirectVariableAccesses(
-    std::set<std::string> &reads, std::set<std::string> &writes) {
+    std::set<VarId> &reads, std::set<VarId> &writes) {
   sqlite3_stmt *stmt;
   std::string query = "DELETE FROM function_variable_direct_accesses WHERE "
                       "funcname = ?;";
@@ -312,14 +317,14 @@ void FunctionEraserSets::saveFunctionDirectVariableAccesses(
   query = "INSERT INTO function_variable_direct_accesses (funcname, "
           "varname, type) VALUES (?, ?, ?);";
 
-  for (const std::string &read : reads) {
-    params = {currFunc, read, "read"};
+  for (VarId read : currVarTable.sortByName(reads)) {
+    params = {currFunc, currVarTable.getName(read), "read"};
     db->prepareStatement(stmt, query, params);
     db->runStatement(stmt);
   }
 
-  for (const std::string &write : writes) {
-    params = {currFunc, write, "write"};
+  for (VarId write : currVarTable.sortByName(writes)) {
+    params = {currFunc, currVarTable.getName(write), "write"};
     db->prepareStatement(stmt, query, params);
     db->runStatement(stmt);
   }
@@ -1,6 +1,10 @@
 #include "function_variable_locksets.h"
+#include "metrics.h"
+#include "set_operations.h"
+#include <algorithm>
 
-FunctionVariableLocksets::FunctionVariableLocksets(Database *db) : db(db) {
+FunctionVariableLocksets::FunctionVariableLocksets(Database *db)
+    : db(db), locksetTable(db) {
   functionLocks = {};
   currFunc = "";
   currId = "";
@@ -32,17 +36,71 @@ std::string FunctionVariableLocksets::getId(std::string funcName,
     if (sqlite3_step(stmt) == SQLITE_ROW) {
       id = db->getStringFromStatement(stmt, 0);
     }
+    sqlite3_finalize(stmt);
   }
   return id;
 }
 
+void FunctionVariableLocksets::updateRoots(
+    const std::set<std::string> &roots) {
+  this->roots = roots;
+
+  sqlite3_stmt *stmt;
+  std::string query = "SELECT funcname FROM roots;";
+  db->prepareStatement(stmt, query);
+  std::set<std::string> oldRoots = {};
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    oldRoots.insert(db->getStringFromStatement(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+
+  std::vector<std::string> params;
+  for (const std::string &root : oldRoots - roots) {
+    params = {root};
+    query = "DELETE FROM function_variable_locksets WHERE testname = ?;";
+    db->prepareStatement(stmt, query, params);
+    db->runStatement(stmt);
+
+    query = "DELETE FROM function_cumulative_locksets WHERE testname = ?;";
+    db->prepareStatement(stmt, query, params);
+    db->runStatement(stmt);
+
+    query = "DELETE FROM roots WHERE funcname = ?;";
+    db->prepareStatement(stmt, query, params);
+    db->runStatement(stmt);
+  }
+
+  for (const std::string &root : roots) {
+    params = {root};
+    query = "SELECT 1 FROM functions_table WHERE funcname = ? AND "
+            "filename IS NOT NULL;";
+    db->prepareStatement(stmt, query, params);
+    bool defined = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    if (!defined) {
+      std::cerr << "Root " << root << " is not a defined function" << std::endl;
+      continue;
+    }
+
+    if (oldRoots.find(root) == oldRoots.end()) {
+      query = "INSERT INTO roots (funcname) VALUES (?);";
+      db->prepareStatement(stmt, query, params);
+      db->runStatement(stmt);
+
+      query = "UPDATE functions_table SET recently_changed = 1 WHERE "
+              "funcname = ?;";
+      db->prepareStatement(stmt, query, params);
+      db->runStatement(stmt);
+    }
+  }
+}
+
 void FunctionVariableLocksets::startNewFunction(std::string funcName) {
   currFunc = funcName;
 }
 
 void FunctionVariableLocksets::startNewTest(std::string testName) {
   currTest = testName;
-  currFuncSets = {};
   currId = getId(currFunc, testName);
 }
 
@@ -68,26 +126,41 @@ void FunctionVariableLocksets::extractFunctionLocksFromDb(
   functionUnlocks.insert({funcName, dbUnlocks});
 }
 
-void FunctionVariableLocksets::applyDeltaLockset(std::set<std::string> &locks,
-                                                 std::string funcName) {
-  std::set<std::string> dbLocks;
-  std::set<std::string> dbUnlocks;
+void FunctionVariableLocksets::getFunctionLocks(
+    std::string funcName, std::set<std::string> &dbLocks,
+    std::set<std::string> &dbUnlocks) {
   if (functionLocks.find(funcName) != functionLocks.end()) {
+    metricCount("function_locks_cache_hits", 1);
     dbLocks = functionLocks[funcName];
     dbUnlocks = functionUnlocks[funcName];
   } else {
+    metricCount("function_locks_cache_misses", 1);
     extractFunctionLocksFromDb(funcName, dbLocks, dbUnlocks);
   }
+}
+
+void FunctionVariableLocksets::applyDeltaLockset(std::set<std::string> &locks,
+                                                 std::string funcName) {
+  std::set<std::string> dbLocks;
+  std::set<std::string> dbUnlocks;
+  getFunctionLocks(funcName, dbLocks, dbUnlocks);
   locks += dbLocks;
   locks -= dbUnlocks;
 }
 
+void FunctionVariableLocksets::applyDeltaLocksetToRemovedLocks(
+    std::set<std::string> &removedLocks, std::string funcName) {
+  std::set<std::string> dbLocks;
+  std::set<std::string> dbUnlocks;
+  getFunctionLocks(funcName, dbLocks, dbUnlocks);
+  removedLocks -= dbLocks;
+}
+
 FunctionInputs FunctionVariableLocksets::updateAndCheckCombinedInputs() {
   FunctionInputs functionInputs = {{}, {}};
-  if (currFunc == "main") {
-    functionInputs.changedTests.insert({"debug", {}});
-    functionInputs.reachableTests = {"debug"};
-    return functionInputs;
+  bool isRoot = roots.find(currFunc) != roots.end();
+  if (isRoot) {
+    functionInputs.changedTests.insert({currFunc, {}});
   }
 
   sqlite3_stmt *stmt;
@@ -101,6 +174,7 @@ FunctionInputs FunctionVariableLocksets::updateAndCheckCombinedInputs() {
       ")";
   std::vector<std::string> params = {currFunc, currFunc};
   db->prepareStatement(stmt, query, params);
+  sqlite3_finalize(stmt);
 
   query = "SELECT id, testname, recently_changed FROM "
           "function_variable_locksets WHERE funcname = ?;";
@@ -117,10 +191,18 @@ FunctionInputs FunctionVariableLocksets::updateAndCheckCombinedInputs() {
   }
   sqlite3_finalize(stmt);
   functionInputs.reachableTests = testnames;
+  if (isRoot && std::find(testnames.begin(), testnames.end(), currFunc) ==
+                    testnames.end()) {
+    functionInputs.reachableTests.push_back(currFunc);
+  }
 
   for (int i = 0; i < ids.size(); i++) {
     std::string id = ids[i];
     std::string testname = testnames[i];
+    // a root's own test always starts with no locks held
+    if (isRoot && testname == currFunc) {
+      continue;
+    }
     bool changed = recentlyChanged[i];
     std::set<std::string> oldCombinedLocks = {};
     if (changed) {
@@ -258,17 +340,15 @@ void FunctionVariableLocksets::addFuncCallLocksets(
     db->prepareStatement(stmt, query, params);
     db->runStatement(stmt);
 
-    query =
-        "SELECT fvlc.id FROM function_variable_locksets_callers AS fvlc JOIN "
-        "function_variable_locksets AS fvl ON fvl.id = "
-        "fvlc.function_variable_locksets_id WHERE caller = "
-        "? AND testname = ?;";
-    params = {currFunc, currTest};
+    query = "SELECT id FROM function_variable_locksets_callers WHERE "
+            "function_variable_locksets_id = ? AND caller = ?;";
+    params = {funcId, currFunc};
     db->prepareStatement(stmt, query, params);
     std::string id;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
       id = db->getStringFromStatement(stmt, 0);
     }
+    sqlite3_finalize(stmt);
 
     query = "INSERT OR IGNORE INTO function_variable_locksets_callers_locks "
             "(function_variable_locksets_callers_id, lock) VALUES (?, ?);";
@@ -292,17 +372,109 @@ void FunctionVariableLocksets::addVariableLocksets(
   db->prepareStatement(stmt, query, params);
   db->runStatement(stmt);
 
+  // variables without an output row hold the empty lockset
+  query = "INSERT INTO function_variable_locksets_outputs "
+          "(function_variable_locksets_id, varname, lockset_id) "
+          "VALUES (?, ?, ?);";
   for (const auto &pair : variableLocksets) {
-    std::string varName = pair.first;
-    std::set<std::string> locks = pair.second;
+    if (pair.second.empty()) {
+      continue;
+    }
+    LocksetId locksetId = locksetTable.intern(pair.second);
+    params = {currId, pair.first, std::to_string(locksetId)};
+    db->prepareStatement(stmt, query, params);
+    db->runStatement(stmt);
+  }
+}
 
-    query = "INSERT INTO function_variable_locksets_outputs "
-            "(function_variable_locksets_id, varname, lock) VALUES (?, ?, ?);";
-    for (const std::string &lock : locks) {
-      params = {currId, varName, lock};
-      db->prepareStatement(stmt, query, params);
-      db->runStatement(stmt);
+bool FunctionVariableLocksets::getMemoisedLocksets(
+    std::string cfgHash, const std::set<std::string> &inputLocks,
+    std::unordered_map<std::string, std::set<std::string>> &funcCallLocksets,
+    std::unordered_map<std::string, std::set<std::string>> &variableLocksets) {
+  sqlite3_stmt *stmt;
+  std::string query =
+      "SELECT id FROM variable_locksets_memo WHERE funcname = ? AND "
+      "cfg_hash = ? AND input_lockset_id = ?;";
+  std::vector<std::string> params = {
+      currFunc, cfgHash, std::to_string(locksetTable.intern(inputLocks))};
+  db->prepareStatement(stmt, query, params);
+  std::string memoId = "";
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    memoId = db->getStringFromStatement(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  if (memoId == "") {
+    metricCount("vl_memo_misses", 1);
+    return false;
+  }
+  metricCount("vl_memo_hits", 1);
+
+  query = "SELECT varname, lockset_id FROM variable_locksets_memo_outputs "
+          "WHERE memo_id = ?;";
+  params = {memoId};
+  db->prepareStatement(stmt, query, params);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    std::string varName = db->getStringFromStatement(stmt, 0);
+    variableLocksets[varName] =
+        locksetTable.get(sqlite3_column_int64(stmt, 1));
+  }
+  sqlite3_finalize(stmt);
+
+  query = "SELECT callee, lockset_id FROM variable_locksets_memo_calls "
+          "WHERE memo_id = ?;";
+  db->prepareStatement(stmt, query, params);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    std::string callee = db->getStringFromStatement(stmt, 0);
+    funcCallLocksets[callee] = locksetTable.get(sqlite3_column_int64(stmt, 1));
+  }
+  sqlite3_finalize(stmt);
+  return true;
+}
+
+void FunctionVariableLocksets::memoiseLocksets(
+    std::string cfgHash, const std::set<std::string> &inputLocks,
+    const std::unordered_map<std::string, std::set<std::string>>
+        &funcCallLocksets,
+    const std::unordered_map<std::string, std::set<std::string>>
+        &variableLocksets) {
+  sqlite3_stmt *stmt;
+  std::string query = "INSERT OR IGNORE INTO variable_locksets_memo "
+                      "(funcname, cfg_hash, input_lockset_id) VALUES "
+                      "(?, ?, ?);";
+  std::vector<std::string> params = {
+      currFunc, cfgHash, std::to_string(locksetTable.intern(inputLocks))};
+  db->prepareStatement(stmt, query, params);
+  db->runStatement(stmt);
+
+  query = "SELECT id FROM variable_locksets_memo WHERE funcname = ? AND "
+          "cfg_hash = ? AND input_lockset_id = ?;";
+  db->prepareStatement(stmt, query, params);
+  std::string memoId = "";
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    memoId = db->getStringFromStatement(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+
+  // as with the outputs, variables with the empty lockset have no row
+  query = "INSERT OR IGNORE INTO variable_locksets_memo_outputs "
+          "(memo_id, varname, lockset_id) VALUES (?, ?, ?);";
+  for (const auto &pair : variableLocksets) {
+    if (pair.second.empty()) {
+      continue;
     }
+    params = {memoId, pair.first,
+              std::to_string(locksetTable.intern(pair.second))};
+    db->prepareStatement(stmt, query, params);
+    db->runStatement(stmt);
+  }
+
+  query = "INSERT OR IGNORE INTO variable_locksets_memo_calls "
+          "(memo_id, callee, lockset_id) VALUES (?, ?, ?);";
+  for (const auto &pair : funcCallLocksets) {
+    params = {memoId, pair.first,
+              std::to_string(locksetTable.intern(pair.second))};
+    db->prepareStatement(stmt, query, params);
+    db->runStatement(stmt);
   }
 }
 
@@ -314,22 +486,20 @@ VariableLocks FunctionVariableLocksets::getVariableLocks() {
   std::vector<std::string> params = {currFunc};
   db->prepareStatement(stmt, query, params);
   VariableLocks variableLocks;
+  LocksetId emptyId = locksetTable.getEmpty();
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     std::string varName = db->getStringFromStatement(stmt, 0);
-    if (variableLocks.find(varName) == variableLocks.end()) {
-      variableLocks.insert({varName, {}});
-    }
+    variableLocks.insert({varName, emptyId});
   }
   sqlite3_finalize(stmt);
 
-  query = "SELECT varname, lock FROM function_variable_locksets_outputs WHERE "
-          "function_variable_locksets_id = ?;";
+  query = "SELECT varname, lockset_id FROM function_variable_locksets_outputs "
+          "WHERE function_variable_locksets_id = ?;";
   params = {currId};
   db->prepareStatement(stmt, query, params);
   while (sqlite3_step(stmt) == SQLITE_ROW) {
     std::string varName = db->getStringFromStatement(stmt, 0);
-    std::string lock = db->getStringFromStatement(stmt, 1);
-    variableLocks[varName].insert(lock);
+    variableLocks[varName] = sqlite3_column_int64(stmt, 1);
   }
   sqlite3_finalize(stmt);
 
@@ -343,6 +513,11 @@ VariableLocks FunctionVariableLocksets::getVariableLocks(std::string func,
   return getVariableLocks();
 }
 
+void FunctionVariableLocksets::clearCache() {
+  functionLocks = {};
+  functionUnlocks = {};
+}
+
 void FunctionVariableLocksets::markFunctionVariableLocksetsAsOld() {
   sqlite3_stmt *stmt;
   std::string query =
@@ -400,4 +575,8 @@ std::vector<std::string> FunctionVariableLocksets::getFunctionsForTesting() {
   }
   sqlite3_finalize(stmt);
   return functions;
+}
+
+LocksetTable *FunctionVariableLocksets::getLocksetTable() {
+  return &locksetTable;
 }
\ No newline at end of file
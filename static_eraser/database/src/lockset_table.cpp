@@ -0,0 +1,116 @@
+#include "lockset_table.h"
+#include "metrics.h"
+#include "set_operations.h"
+
+LocksetTable::LocksetTable(Database *db) : db(db) {}
+
+// lock names are C expressions, so they never contain a newline. Every lock
+// is preceded by one, as a name may be empty and {""} must not share the key
+// of {}
+std::string LocksetTable::createKey(const std::set<std::string> &locks) {
+  std::string key = "";
+  for (const std::string &lock : locks) {
+    key += "\n" + lock;
+  }
+  return key;
+}
+
+void LocksetTable::cache(LocksetId id, const std::string &key,
+                         const std::set<std::string> &locks) {
+  ids.insert({key, id});
+  locksets.insert({id, locks});
+}
+
+LocksetId LocksetTable::intern(const std::set<std::string> &locks) {
+  std::string key = createKey(locks);
+  auto it = ids.find(key);
+  if (it != ids.end()) {
+    return it->second;
+  }
+
+  sqlite3_stmt *stmt;
+  std::string query = "SELECT id FROM locksets WHERE locks = ?;";
+  std::vector<std::string> params = {key};
+  db->prepareStatement(stmt, query, params);
+  LocksetId id = 0;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    id = sqlite3_column_int64(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+
+  if (id == 0) {
+    query = "INSERT INTO locksets (locks) VALUES (?);";
+    db->prepareStatement(stmt, query, params);
+    db->runStatement(stmt);
+
+    query = "SELECT id FROM locksets WHERE locks = ?;";
+    db->prepareStatement(stmt, query, params);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      id = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    metricCount("locksets_created", 1);
+  }
+
+  cache(id, key, locks);
+  return id;
+}
+
+const std::set<std::string> &LocksetTable::get(LocksetId id) {
+  auto it = locksets.find(id);
+  if (it != locksets.end()) {
+    return it->second;
+  }
+
+  sqlite3_stmt *stmt;
+  std::string query = "SELECT locks FROM locksets WHERE id = ?;";
+  std::vector<std::string> params = {std::to_string(id)};
+  db->prepareStatement(stmt, query, params);
+  std::string key = "";
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    key = db->getStringFromStatement(stmt, 0);
+  } else {
+    std::cerr << "Unknown lockset " << id << std::endl;
+  }
+  sqlite3_finalize(stmt);
+
+  std::set<std::string> locks = {};
+  size_t start = 0;
+  while (start < key.size()) {
+    size_t end = key.find('\n', start + 1);
+    if (end == std::string::npos) {
+      end = key.size();
+    }
+    locks.insert(key.substr(start + 1, end - start - 1));
+    start = end;
+  }
+  if (createKey(locks) != key) {
+    std::cerr << "Lockset " << id << " is not in the expected format"
+              << std::endl;
+  }
+  cache(id, key, locks);
+  return locksets[id];
+}
+
+LocksetId LocksetTable::intersect(LocksetId a, LocksetId b) {
+  if (a == b) {
+    return a;
+  }
+  uint64_t key = a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+  auto it = intersections.find(key);
+  if (it != intersections.end()) {
+    metricCount("lockset_intersection_cache_hits", 1);
+    return it->second;
+  }
+  metricCount("lockset_intersection_cache_misses", 1);
+  LocksetId result = intern(get(a) * get(b));
+  intersections.insert({key, result});
+  return result;
+}
+
+LocksetId LocksetTable::getEmpty() {
+  if (emptyId == 0) {
+    emptyId = intern({});
+  }
+  return emptyId;
+}
@@ -0,0 +1,200 @@
+#include "sql_profiler.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+SqlProfiler::SqlProfiler(sqlite3 *db) : db(db) { startTracing(); }
+
+SqlProfiler::~SqlProfiler() { sqlite3_trace_v2(db, 0, nullptr, nullptr); }
+
+void SqlProfiler::startTracing() {
+  sqlite3_trace_v2(db,
+                   SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW,
+                   &SqlProfiler::traceCallback, this);
+}
+
+int SqlProfiler::traceCallback(unsigned int type, void *context, void *p,
+                               void *x) {
+  SqlProfiler *profiler = reinterpret_cast<SqlProfiler *>(context);
+  sqlite3_stmt *stmt = reinterpret_cast<sqlite3_stmt *>(p);
+  if (type == SQLITE_TRACE_STMT) {
+    profiler->recordStart(stmt);
+  } else if (type == SQLITE_TRACE_ROW) {
+    profiler->recordRow(stmt);
+  } else if (type == SQLITE_TRACE_PROFILE) {
+    profiler->recordProfile(stmt, *reinterpret_cast<sqlite3_int64 *>(x));
+  }
+  return 0;
+}
+
+// Collapses whitespace and replaces literals and parameter lists with
+// placeholders, so that "IN (?, ?, ?)" and "IN (?)" count as one query.
+std::string SqlProfiler::normalizeQuery(const char *sql) {
+  std::string result;
+  for (const char *c = sql; *c != '\0'; c++) {
+    if (std::isspace((unsigned char)*c)) {
+      if (!result.empty() && result.back() != ' ') {
+        result += ' ';
+      }
+    } else if (*c == '\'') {
+      while (*(c + 1) != '\0' && *(c + 1) != '\'') {
+        c++;
+      }
+      if (*(c + 1) != '\0') {
+        c++;
+      }
+      result += '?';
+    } else if (std::isdigit((unsigned char)*c) &&
+               (result.empty() ||
+                !(std::isalnum((unsigned char)result.back()) ||
+                  result.back() == '_'))) {
+      while (std::isdigit((unsigned char)*(c + 1)) || *(c + 1) == '.') {
+        c++;
+      }
+      result += '?';
+    } else {
+      result += *c;
+    }
+  }
+  while (!result.empty() && result.back() == ' ') {
+    result.pop_back();
+  }
+
+  size_t pos = result.find("(?");
+  while (pos != std::string::npos) {
+    size_t end = pos + 2;
+    while (result.compare(end, 3, ", ?") == 0) {
+      end += 3;
+    }
+    if (result.compare(end, 1, ")") == 0) {
+      result.replace(pos, end - pos + 1, "(?, ...)");
+    }
+    pos = result.find("(?", pos + 1);
+  }
+  return result;
+}
+
+void SqlProfiler::recordStart(sqlite3_stmt *stmt) {
+  PendingStatement &statement = pending[stmt];
+  statement.start = std::chrono::steady_clock::now();
+  statement.rows = 0;
+}
+
+void SqlProfiler::recordRow(sqlite3_stmt *stmt) { pending[stmt].rows++; }
+
+void SqlProfiler::recordProfile(sqlite3_stmt *stmt, long long ns) {
+  const char *sql = sqlite3_sql(stmt);
+  if (sql == nullptr) {
+    return;
+  }
+  std::string query = normalizeQuery(sql);
+  QueryProfile &profile = profiles[query];
+  if (profile.calls == 0) {
+    profile.query = query;
+    profile.example = sql;
+  }
+  auto statement = pending.find(stmt);
+  if (statement != pending.end()) {
+    ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - statement->second.start)
+             .count();
+    profile.rows += statement->second.rows;
+    pending.erase(statement);
+  }
+  profile.calls++;
+  profile.totalNs += ns;
+  profile.vmSteps += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+  profile.fullScanSteps +=
+      sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+}
+
+std::vector<QueryProfile> SqlProfiler::getProfiles() {
+  std::vector<QueryProfile> result;
+  for (const auto &pair : profiles) {
+    result.push_back(pair.second);
+  }
+  std::sort(result.begin(), result.end(),
+            [](const QueryProfile &a, const QueryProfile &b) {
+              return a.totalNs > b.totalNs;
+            });
+  return result;
+}
+
+std::string SqlProfiler::explainQueryPlan(const std::string &sql) {
+  // the plan statement itself should not show up in the profile
+  sqlite3_trace_v2(db, 0, nullptr, nullptr);
+  std::string plan;
+  sqlite3_stmt *stmt;
+  std::string query = "EXPLAIN QUERY PLAN " + sql;
+  if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      const unsigned char *detail = sqlite3_column_text(stmt, 3);
+      if (detail != nullptr) {
+        plan += (plan.empty() ? "" : "; ") + std::string((const char *)detail);
+      }
+    }
+    sqlite3_finalize(stmt);
+  }
+  startTracing();
+  return plan;
+}
+
+void SqlProfiler::printReport(std::ostream &stream, int top) {
+  std::vector<QueryProfile> sorted = getProfiles();
+  long long totalNs = 0;
+  long long totalCalls = 0;
+  for (const QueryProfile &profile : sorted) {
+    totalNs += profile.totalNs;
+    totalCalls += profile.calls;
+  }
+  stream << "SQL profile: " << totalCalls << " statements in " << sorted.size()
+         << " distinct queries, " << std::fixed << std::setprecision(1)
+         << totalNs / 1e6 << "ms" << std::endl;
+  for (int i = 0; i < top && i < (int)sorted.size(); i++) {
+    QueryProfile &profile = profiles[sorted[i].query];
+    if (profile.plan.empty()) {
+      profile.plan = explainQueryPlan(profile.example);
+    }
+    stream << std::setw(3) << i + 1 << ". " << std::setprecision(1)
+           << profile.totalNs / 1e6 << "ms total, " << profile.calls
+           << " calls, " << std::setprecision(3)
+           << profile.totalNs / 1e3 / profile.calls << "us avg, "
+           << profile.rows << " rows, " << profile.vmSteps << " vm steps, "
+           << profile.fullScanSteps << " full scan steps" << std::endl;
+    stream << "     " << profile.query << std::endl;
+    if (!profile.plan.empty()) {
+      stream << "     plan: " << profile.plan << std::endl;
+    }
+  }
+  stream << std::defaultfloat;
+}
+
+static std::string csvField(const std::string &value) {
+  std::string result = "\"";
+  for (char c : value) {
+    result += c == '"' ? "\"\"" : std::string(1, c);
+  }
+  return result + "\"";
+}
+
+bool SqlProfiler::writeCsv(const std::string &path) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open " << path << " for writing." << std::endl;
+    return false;
+  }
+  file << "query,calls,total_ms,avg_us,rows,vm_steps,full_scan_steps,plan\n";
+  for (const QueryProfile &sortedProfile : getProfiles()) {
+    QueryProfile &profile = profiles[sortedProfile.query];
+    if (profile.plan.empty()) {
+      profile.plan = explainQueryPlan(profile.example);
+    }
+    file << csvField(profile.query) << "," << profile.calls << ","
+         << profile.totalNs / 1e6 << "," << profile.totalNs / 1e3 / profile.calls
+         << "," << profile.rows << "," << profile.vmSteps << ","
+         << profile.fullScanSteps << "," << csvField(profile.plan) << "\n";
+  }
+  return true;
+}
@@ -1,12 +1,21 @@
 #pragma once
 #include "basic_node.h"
 
+// CFG_TRIVIAL: no reads, writes, locks, calls, threads or loops, so the
+// function has the default summary and all trivial functions share one CFG.
+// CFG_ACYCLIC: no loops, calls or thread creates, so every edge goes to a
+// node with a higher id and the CFG can be handled in one pass in id order.
+enum CfgKind { CFG_GENERAL, CFG_ACYCLIC, CFG_TRIVIAL };
+
 class StartNode : public BasicNode {
 public:
   explicit StartNode(std::string funcName);
   virtual ~StartNode();
 
   std::string getPrintableName();
+  std::vector<GraphNode *> getNodesInIdOrder();
+
+  CfgKind kind = CFG_GENERAL;
 
 private:
   std::string funcName;
@@ -1,7 +1,10 @@
 #include "graph_node.h"
+#include "metrics.h"
 #include "node_types.h"
 
-GraphNode::GraphNode(NodeType type) : type(type) {}
+GraphNode::GraphNode(NodeType type) : type(type) {
+  metricCount("cfg_nodes_created", 1);
+}
 
 std::string GraphNode::getPrintableNameWithId() {
   return std::to_string(id) + " " + getPrintableName();
@@ -1,5 +1,7 @@
 #include "start_node.h"
 #include "node_types.h"
+#include <algorithm>
+#include <unordered_set>
 
 StartNode::StartNode(std::string funcName)
     : funcName(funcName), BasicNode::BasicNode(NodeType::START) {
@@ -7,4 +9,21 @@ StartNode::StartNode(std::string funcName)
 }
 StartNode::~StartNode() = default;
 
-std::string StartNode::getPrintableName() { return "Function " + funcName; }
\ No newline at end of file
+std::string StartNode::getPrintableName() { return "Function " + funcName; }
+
+// every node reachable from this one, for CFG_ACYCLIC this is a topological
+// order
+std::vector<GraphNode *> StartNode::getNodesInIdOrder() {
+  std::unordered_set<GraphNode *> visited = {this};
+  std::vector<GraphNode *> nodes = {this};
+  for (size_t i = 0; i < nodes.size(); i++) {
+    for (GraphNode *nextNode : nodes[i]->getNextNodes()) {
+      if (visited.insert(nextNode).second) {
+        nodes.push_back(nextNode);
+      }
+    }
+  }
+  std::sort(nodes.begin(), nodes.end(),
+            [](GraphNode *a, GraphNode *b) { return a->id < b->id; });
+  return nodes;
+}
\ No newline at end of file
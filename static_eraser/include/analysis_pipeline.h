@@ -0,0 +1,93 @@
+#pragma once
+#include "call_graph.h"
+#include "checkpoints.h"
+#include "database.h"
+#include "file_includes.h"
+#include "function_budget.h"
+#include "function_cumulative_locksets.h"
+#include "function_eraser_sets.h"
+#include "function_variable_locksets.h"
+#include "parser.h"
+#include "race_reporter.h"
+#include "summary_cache.h"
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// Runs the analysis phases in the order main expects them, one phase per
+// call, so that tools can time or skip individual phases. Each update returns
+// the number of functions the phase visited.
+class AnalysisPipeline {
+public:
+  explicit AnalysisPipeline(Database *db);
+  virtual ~AnalysisPipeline() = default;
+
+  FileIncludes *getFileIncludes();
+  CallGraph *getCallGraph();
+  Parser *getParser();
+  LocksetTable *getLocksetTable();
+  // entry points analysed by phases 2 and 3, only main unless set
+  void setRoots(const std::set<std::string> &roots);
+  // phase 1 only visits functions reachable from the roots, the others are
+  // left for updateDeferredDeltaLocksets, which must run before
+  // markResultsAsOld
+  void setPriorityOrdering(bool priorityOrdering);
+  // phase 3 writes races to the stream as JSON lines as they are confirmed
+  void setRaceStream(std::ostream *stream);
+  // limits the dataflow of every function in phases 1 and 2, functions that
+  // exceed it get a pessimistic summary instead
+  void setFunctionBudget(const FunctionBudget &budget);
+  // functions whose summaries are widened, they are analysed again by the
+  // next parseChangedFiles
+  std::set<std::string> getWidenedFunctions();
+  // the longest a phase runs between commits of its progress
+  void setCheckpointInterval(long long intervalMs);
+  Checkpoints *getCheckpoints();
+  // phase 1 reuses the summaries of functions whose CFG and callee summaries
+  // match ones stored in the directory, and stores the rest there
+  void setSummaryCache(const std::string &directory);
+
+  // starts a run, the pipeline can run any number of times and keeps the
+  // CFGs of files that did not change
+  void parseChangedFiles(const std::set<std::string> &changedFiles);
+  // continues an interrupted run in place of parseChangedFiles, the phases
+  // then skip the work that was committed before the interruption
+  void resumeRun();
+  int updateDeltaLocksets();
+  // phase 1 of the functions --priority deferred, then phase 3 of the ones
+  // phase 3 left out for having no summary yet
+  int updateDeferredDeltaLocksets();
+  // phases 2 and 3 run on the pipeline's connection and visit each function
+  // once, handling the tests of every root that reaches it in turn
+  int updateVariableLocksets();
+  int updateCumulativeLocksets();
+  void markResultsAsOld();
+  // races of every root, one worker thread per root up to the number of
+  // cores, each with its own connection to the database
+  std::map<std::string, std::set<std::string>> detectDataRacesPerRoot();
+  // races of all roots combined
+  std::set<std::string> detectDataRaces();
+
+private:
+  Database *db;
+  FunctionEraserSets functionEraserSets;
+  CallGraph callGraph;
+  FileIncludes fileIncludes;
+  Parser parser;
+  FunctionVariableLocksets functionVariableLocksets;
+  FunctionCumulativeLocksets functionCumulativeLocksets;
+  std::vector<std::string> functions;
+  std::set<std::string> roots = {"main"};
+  bool priorityOrdering = false;
+  FunctionBudget functionBudget;
+  std::unique_ptr<RaceReporter> raceReporter;
+  std::unique_ptr<SummaryCache> summaryCache;
+  Checkpoints checkpoints;
+
+  void parseFiles(const std::vector<std::string> &files);
+  int visitDeferredDeltaLocksets();
+  void visitDeferredCumulativeLocksets();
+};
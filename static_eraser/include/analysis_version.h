@@ -0,0 +1,8 @@
+#pragma once
+
+// Version of what the analysis stores, bumped by every change that alters
+// the summaries, tables or races produced for the same code, for example a
+// new encoding of locksets. Cached summaries and snapshots are keyed on it
+// rather than on the tool version, which only changes with releases, and
+// databases of another version are analysed again from scratch.
+constexpr int analysisVersion = 1;
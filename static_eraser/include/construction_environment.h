@@ -32,10 +32,29 @@ public:
   void onAdd(ContinueReturnNode *node);
   void onAdd(ReturnNode *node);
 
+  CfgKind getCfgKind();
+  void sliceCfg();
+
 private:
+  // an if (whileNode == nullptr) or loop without events, so it only matters
+  // to the dataflow as a join point
+  struct SliceRegion {
+    GraphNode *entry;
+    WhileNode *whileNode;
+    GraphNode *exit;
+  };
+
   int currId;
+  bool hasLoops;
+  bool hasCalls;
+  bool hasEffects;
+  // effect and return nodes added so far
+  int events;
   void callOnAdd(GraphNode *node);
   void setNodeId(GraphNode *node);
+  void addSliceRegion(GraphNode *entry, WhileNode *whileNode,
+                      GraphNode *exit);
+  void onLoopJump();
 
   std::vector<IfNode *> ifStack;
   std::vector<std::vector<BasicNode *>> endifListStack;
@@ -43,4 +62,10 @@ private:
   std::vector<StartwhileNode *> startwhileStack;
   std::vector<std::vector<BreakNode *>> breakListStack;
   std::vector<std::vector<ContinueNode *>> continueListStack;
+  // events when each open if started, or -1 once a break or continue leaves it
+  std::vector<int> ifEventsStack;
+  std::vector<int> loopEventsStack;
+  // open ifs when each open loop started
+  std::vector<size_t> loopIfDepthStack;
+  std::vector<SliceRegion> sliceRegions;
 };
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 #include "call_graph.h"
+#include "checkpoints.h"
 #include "function_cumulative_locksets.h"
+#include "race_reporter.h"
 #include "set_operations.h"
 #include "start_node.h"
 #include <unordered_map>
@@ -13,9 +15,23 @@ public:
       FunctionCumulativeLocksets *functionCumulativeLocksets);
   virtual ~CumulativeLocksets() = default;
 
+  // reports races while the locksets are updated, off unless set
+  void setRaceReporter(RaceReporter *raceReporter,
+                       const std::set<std::string> &roots);
   void updateLocksets();
+  // the bottom up ordering of the functions whose locksets may have changed
+  std::vector<std::string> getOrdering();
+  // visits the functions of the ordering that need it, from the checkpointed
+  // position when checkpoints are set
+  void visitFunctions(const std::vector<std::string> &ordering);
+  void setCheckpoints(Checkpoints *checkpoints);
+  int getFunctionsVisited();
 
 private:
+  int functionsVisited = 0;
+  RaceReporter *raceReporter = nullptr;
+  Checkpoints *checkpoints = nullptr;
+  std::set<std::string> roots = {};
   CallGraph *callGraph;
   FunctionCumulativeLocksets *functionCumulativeLocksets;
 };
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once
 #include "break_node.h"
 #include "call_graph.h"
+#include "checkpoints.h"
 #include "continue_node.h"
 #include "endif_node.h"
 #include "endwhile_node.h"
 #include "eraser_sets.h"
+#include "function_budget.h"
 #include "function_call_node.h"
 #include "function_eraser_sets.h"
 #include "graph_node.h"
@@ -15,6 +17,7 @@
 #include "return_node.h"
 #include "set_operations.h"
 #include "start_node.h"
+#include "summary_cache.h"
 #include "thread_create_node.h"
 #include "thread_join_node.h"
 #include "unlock_node.h"
@@ -28,14 +31,31 @@ public:
   virtual ~DeltaLockset() = default;
 
   void updateLocksets(std::vector<std::string> changedFunctions);
+  // visits the functions of a bottom up ordering that need it, from the
+  // checkpointed position when checkpoints are set
+  void visitFunctions(const std::vector<std::string> &ordering);
+  void setBudget(const FunctionBudget &budget);
+  void setCheckpoints(Checkpoints *checkpoints);
+  // summaries are looked up before and stored after each dataflow
+  void setSummaryCache(SummaryCache *summaryCache);
+  int getFunctionsVisited();
+  // functions whose dataflow ran out of budget, in the order visited
+  std::vector<std::string> getWidenedFunctions();
 
 private:
+  int functionsVisited = 0;
+  FunctionBudget budget;
+  Checkpoints *checkpoints = nullptr;
+  SummaryCache *summaryCache = nullptr;
+  bool widened = false;
+  std::vector<std::string> widenedFunctions = {};
   bool recursive;
   CallGraph *callGraph;
   Parser *parser;
   FunctionEraserSets *functionEraserSets;
-  std::set<std::string> functionDirectReads = {};
-  std::set<std::string> functionDirectWrites = {};
+  std::set<VarId> functionDirectReads = {};
+  std::set<VarId> functionDirectWrites = {};
+  std::set<std::string> functionRecursiveUnlocks = {};
 
   std::priority_queue<GraphNode *, std::vector<GraphNode *>, CompareGraphNode>
       forwardQueue = {};
@@ -44,13 +64,19 @@ private:
 
   std::string currFunc;
   std::unordered_map<GraphNode *, EraserSets> nodeSets = {};
+  // the variable of each node of the current function that has one, and the
+  // sets of its callees, interned into the VarTable of the function
+  std::unordered_map<GraphNode *, VarId> nodeVars = {};
+  std::unordered_map<std::string, EraserSets> calleeSets = {};
 
-  bool variableRead(std::string varName, EraserSets &sets);
-  bool variableWrite(std::string varName, EraserSets &sets);
+  void internFunction(StartNode *startNode);
+  EraserSets *getCalleeSets(const std::string &functionName);
+  bool variableRead(VarId var, EraserSets &sets);
+  bool variableWrite(VarId var, EraserSets &sets);
   bool recursiveFunctionCall(std::string functionName, EraserSets &sets,
                              bool fromThread);
 
-  void threadFinished(std::string varName, EraserSets &sets);
+  void threadFinished(VarId var, EraserSets &sets);
 
   bool handleNode(FunctionCallNode *node, EraserSets &sets);
   bool handleNode(ThreadCreateNode *node, EraserSets &sets);
@@ -65,5 +91,11 @@ private:
   bool handleNode(GraphNode *node, EraserSets &sets);
 
   void addNodeToQueue(GraphNode *startNode, GraphNode *nextNode);
-  void handleFunction(GraphNode *startNode);
+  void runLinearPass(StartNode *startNode);
+  void runDataflow(GraphNode *startNode);
+  void widenFunction(StartNode *startNode);
+  std::string getSummaryKey(StartNode *startNode);
+  bool loadSummary(StartNode *startNode, const std::string &summaryKey);
+  void storeSummary(StartNode *startNode, const std::string &summaryKey);
+  void handleFunction(StartNode *startNode);
 };
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <stdexcept>
 #include <string>
 #include <array>
+#include <vector>
 
 class DiffAnalysis {
 public:
@@ -20,6 +21,11 @@ public:
 
   std::set<std::string> getAllFiles(const std::string &repoPath);
 
+  // commits the commit descends from, most recent first, starting with the
+  // commit itself
+  std::vector<std::string> getAncestors(const std::string &repoPath,
+                                        const std::string &commitHash = "HEAD");
+
 private:
   FileIncludes *fileIncludes;
   std::string executeCommand(const std::string &command);
@@ -0,0 +1,67 @@
+#pragma once
+#include "analysis_pipeline.h"
+#include "database.h"
+#include <map>
+#include <set>
+#include <string>
+
+struct FunctionSummary {
+  bool found;
+  std::string fileName;
+  // phase 1: locks acquired and released, and the states of the variables
+  // the function accesses
+  std::set<std::string> locks;
+  std::set<std::string> unlocks;
+  std::map<std::string, std::set<std::string>> variableStates;
+  // phase 2: test -> variable -> locks held on every access
+  std::map<std::string, std::map<std::string, std::set<std::string>>>
+      variableLocksets;
+};
+
+struct AnalysisResult {
+  int filesSubmitted;
+  // functions visited by each phase
+  int phase1Functions;
+  int phase2Functions;
+  int phase3Functions;
+  long long durationMs;
+};
+
+// In-process interface to the engine for tools that analyse repeatedly, such
+// as editors and pre-commit hooks. A session keeps its database connection,
+// the CFGs of unchanged files and the parsed headers between analyses, so an
+// analysis only pays for the files submitted since the last one.
+class EraserSession {
+public:
+  // fresh deletes the database left at dbPath by earlier sessions, a
+  // database of another analysis version is always deleted
+  explicit EraserSession(const std::string &dbPath = Database::dbName,
+                         bool fresh = false);
+  virtual ~EraserSession() = default;
+
+  // entry points, only main unless set
+  void setRoots(const std::set<std::string> &roots);
+  // every .c and .h file under the directory
+  void submitDirectory(const std::string &path);
+  // a file changed or deleted on disk, drops any buffer submitted for it
+  void submitFile(const std::string &fileName);
+  // contents parsed in place of the file on disk, e.g. an unsaved editor
+  // buffer, until the file itself is submitted
+  void submitBuffer(const std::string &fileName, const std::string &contents);
+
+  // runs every phase and race detection on the submitted files
+  AnalysisResult analyse();
+
+  // races found by the last analysis
+  std::set<std::string> getDataRaces();
+  std::map<std::string, std::set<std::string>> getDataRacesPerRoot();
+  FunctionSummary getFunctionSummary(const std::string &funcName);
+
+private:
+  Database db;
+  AnalysisPipeline pipeline;
+  std::set<std::string> submittedFiles = {};
+  std::map<std::string, std::set<std::string>> dataRaces = {};
+
+  void addSubmittedFile(const std::string &fileName);
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "set_operations.h"
+#include "var_state.h"
 #include <functional>
 #include <memory>
 #include <queue>
@@ -7,100 +8,160 @@
 #include <unordered_map>
 #include <vector>
 
-// varName -> tid
-struct ActiveThreads
-    : public std::unordered_map<std::string, std::set<std::string>> {
-  ActiveThreads &operator+=(const ActiveThreads &other) {
-    for (auto &pair : other) {
-      if (find(pair.first) != end()) {
-        at(pair.first) += pair.second;
-      } else {
-        insert(pair);
-      }
+typedef std::unordered_map<std::string, std::set<VarId>> TidVarsMap;
+
+// VarId -> tids, a dense array over the ids of one VarTable. The tids of a
+// variable count the references to it, and a variable with no tids is not in
+// the map, so lookups, insertions and removals by variable are O(1) indexing.
+class VarTids {
+public:
+  bool contains(VarId var) const {
+    return var < tids.size() && !tids[var].empty();
+  }
+
+  const std::set<std::string> &getTids(VarId var) const {
+    static const std::set<std::string> empty = {};
+    return var < tids.size() ? tids[var] : empty;
+  }
+
+  // every variable in the map is below varEnd()
+  VarId varEnd() const { return tids.size(); }
+
+  void insert(VarId var, const std::string &tid) {
+    if (var >= tids.size()) {
+      tids.resize(var + 1);
     }
-    return *this;
+    tids[var].insert(tid);
   }
 
-  ActiveThreads operator+(const ActiveThreads &other) const {
-    ActiveThreads result = *this;
-    return result += other;
+  void erase(VarId var, const std::string &tid) {
+    if (var < tids.size()) {
+      tids[var].erase(tid);
+    }
   }
 
-  ActiveThreads &operator-=(const std::set<std::string> &other) {
-    for (auto &varName : other) {
-      erase(varName);
+  void erase(VarId var) {
+    if (var < tids.size()) {
+      tids[var].clear();
+    }
+  }
+
+  VarTids &operator+=(const VarTids &other) {
+    if (other.tids.size() > tids.size()) {
+      tids.resize(other.tids.size());
+    }
+    for (VarId var = 0; var < other.tids.size(); var++) {
+      if (!other.tids[var].empty()) {
+        tids[var] += other.tids[var];
+      }
     }
     return *this;
   }
 
-  ActiveThreads operator-(const std::set<std::string> &other) const {
-    ActiveThreads result = *this;
-    return result -= other;
+  VarTids &operator-=(const std::set<VarId> &vars) {
+    for (VarId var : vars) {
+      erase(var);
+    }
+    return *this;
   }
-};
 
-// Q: (tid -> pending writes)
-struct QueuedWrites
-    : public std::unordered_map<std::string, std::set<std::string>> {
-  std::set<std::string> values() {
-    std::set<std::string> result;
-    for (auto &pair : *this) {
-      result += pair.second;
+  // arrays of different lengths are equal if the longer one only adds
+  // variables with no tids
+  bool operator==(const VarTids &other) const {
+    size_t end = std::max(tids.size(), other.tids.size());
+    for (VarId var = 0; var < end; var++) {
+      if (getTids(var) != other.getTids(var)) {
+        return false;
+      }
     }
-    return result;
+    return true;
   }
 
-  QueuedWrites removeVars(std::set<std::string> vars) {
-    for (auto it = begin(); it != end();) {
-      it->second -= vars;
-      if (it->second.empty()) {
-        it = erase(it);
-      } else {
-        ++it;
+private:
+  std::vector<std::set<std::string>> tids;
+};
+
+// var -> tids of the threads it was created by that may still be running
+typedef VarTids ActiveThreads;
+
+// Q: (tid -> pending writes), with an index from each pending write back to
+// the tids queueing it so that lookups and removals by variable do not scan
+// every thread. A tid never maps to an empty set.
+class QueuedWrites {
+public:
+  bool containsVar(VarId var) const { return tidsByVar.contains(var); }
+
+  // every variable with a pending write is below varEnd()
+  VarId varEnd() const { return tidsByVar.varEnd(); }
+
+  const std::set<VarId> &getWrites(const std::string &tid) const {
+    static const std::set<VarId> empty = {};
+    auto it = writes.find(tid);
+    return it == writes.end() ? empty : it->second;
+  }
+
+  void insert(const std::string &tid, VarId var) {
+    writes[tid].insert(var);
+    tidsByVar.insert(var, tid);
+  }
+
+  void removeVar(VarId var) {
+    for (const std::string &tid : tidsByVar.getTids(var)) {
+      std::set<VarId> &tidWrites = writes[tid];
+      tidWrites.erase(var);
+      if (tidWrites.empty()) {
+        writes.erase(tid);
       }
     }
-    return *this;
+    tidsByVar.erase(var);
   }
 
-  QueuedWrites removeVar(std::string var) {
-    for (auto it = begin(); it != end();) {
-      it->second.erase(var);
-      if (it->second.empty()) {
-        it = erase(it);
-      } else {
-        ++it;
+  // drops the pending writes to every variable in one of the given states
+  void removeVarsInState(const VarStates &vars, VarStateMask state) {
+    for (VarId var = 0; var < tidsByVar.varEnd(); var++) {
+      if ((vars.get(var) & state) && tidsByVar.contains(var)) {
+        removeVar(var);
       }
     }
-    return *this;
+  }
+
+  void removeThread(const std::string &tid) {
+    auto it = writes.find(tid);
+    if (it == writes.end()) {
+      return;
+    }
+    for (VarId var : it->second) {
+      tidsByVar.erase(var, tid);
+    }
+    writes.erase(it);
   }
 
   QueuedWrites &operator+=(const QueuedWrites &other) {
-    for (auto &pair : other) {
-      if (find(pair.first) != end()) {
-        at(pair.first) += pair.second;
-      } else {
-        insert(pair);
+    for (auto &pair : other.writes) {
+      for (VarId var : pair.second) {
+        insert(pair.first, var);
       }
     }
     return *this;
   }
 
-  QueuedWrites operator+(const QueuedWrites &other) const {
-    QueuedWrites result = *this;
-    return result += other;
-  }
-
-  QueuedWrites &operator-=(const std::set<std::string> &other) {
-    for (auto &tid : other) {
-      erase(tid);
+  QueuedWrites &operator-=(const std::set<std::string> &tids) {
+    for (auto &tid : tids) {
+      removeThread(tid);
     }
     return *this;
   }
 
-  QueuedWrites operator-(const std::set<std::string> &other) const {
-    QueuedWrites result = *this;
-    return result -= other;
+  TidVarsMap::const_iterator begin() const { return writes.begin(); }
+  TidVarsMap::const_iterator end() const { return writes.end(); }
+
+  bool operator==(const QueuedWrites &other) const {
+    return writes == other.writes;
   }
+
+private:
+  TidVarsMap writes;
+  VarTids tidsByVar;
 };
 
 struct EraserSets {
@@ -108,18 +169,13 @@ struct EraserSets {
   std::set<std::string> locks;
   std::set<std::string> unlocks;
 
-  // state machine state representation
-  std::set<std::string> externalReads;
-  std::set<std::string> internalReads;
-  std::set<std::string> externalWrites;
-  std::set<std::string> internalWrites;
-  std::set<std::string> internalShared;
-  std::set<std::string> externalShared;
-  std::set<std::string> sharedModified;
+  // state machine state representation, indexed by the VarTable of the
+  // function the sets belong to
+  VarStates vars;
   QueuedWrites queuedWrites;
 
   // threads
-  std::set<std::string> finishedThreads;
+  std::set<VarId> finishedThreads;
   ActiveThreads activeThreads;
   bool eraserIgnoreOn;
 
@@ -128,14 +184,7 @@ struct EraserSets {
   }
 
   bool varsEqual(const EraserSets &other) const {
-    return externalReads == other.externalReads &&
-           internalReads == other.internalReads &&
-           externalWrites == other.externalWrites &&
-           internalWrites == other.internalWrites &&
-           internalShared == other.internalShared &&
-           externalShared == other.externalShared &&
-           sharedModified == other.sharedModified &&
-           queuedWrites == other.queuedWrites &&
+    return vars == other.vars && queuedWrites == other.queuedWrites &&
            finishedThreads == other.finishedThreads &&
            activeThreads == other.activeThreads;
   }
@@ -150,5 +199,5 @@ struct EraserSets {
   static const EraserSets defaultValue;
 };
 
-const inline EraserSets EraserSets::defaultValue = {{}, {}, {}, {}, {}, {},  {},
-                                                    {}, {}, {}, {}, {}, true};
\ No newline at end of file
+const inline EraserSets EraserSets::defaultValue = {{}, {}, {}, {},
+                                                    {}, {}, true};
\ No newline at end of file
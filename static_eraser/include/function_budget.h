@@ -0,0 +1,29 @@
+#pragma once
+#include <chrono>
+
+// Limits on the dataflow of a single function in phases 1 and 2, 0 means
+// unlimited. Iterations count worklist pops and the state size is the number
+// of entries in the state of the node being handled.
+struct FunctionBudget {
+  int maxIterations = 0;
+  long long maxMs = 0;
+  int maxStateSize = 0;
+
+  bool isUnlimited() const {
+    return maxIterations == 0 && maxMs == 0 && maxStateSize == 0;
+  }
+};
+
+// Tracks the budget of one run of a dataflow.
+class BudgetTracker {
+public:
+  explicit BudgetTracker(const FunctionBudget &budget);
+  virtual ~BudgetTracker() = default;
+
+  // called once per worklist pop
+  bool exceeded(int iterations, int stateSize);
+
+private:
+  const FunctionBudget &budget;
+  std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// ERASER_METRICS is set by the CMake option of the same name, without it
+// every metric macro below compiles to nothing.
+
+struct MetricCounter {
+  std::atomic<long long> value{0};
+};
+
+struct MetricHistogram {
+  std::vector<double> bounds;
+  std::vector<long long> buckets;
+  long long count = 0;
+  double sum = 0;
+};
+
+// Process wide registry of named counters, timers, histograms and gauges.
+// Names must be valid Prometheus metric names, timers are histograms of
+// milliseconds.
+class Metrics {
+public:
+  static Metrics &instance();
+
+  MetricCounter &counter(const std::string &name);
+  MetricHistogram &histogram(const std::string &name);
+  void observe(MetricHistogram &histogram, double value);
+  void setGauge(const std::string &name, double value);
+
+  // records process wide gauges such as the peak RSS
+  void updateProcessGauges();
+  void reset();
+
+  void writeJson(std::ostream &stream);
+  void writePrometheus(std::ostream &stream);
+
+private:
+  explicit Metrics() = default;
+
+  std::map<std::string, MetricCounter> counters;
+  std::map<std::string, MetricHistogram> histograms;
+  std::map<std::string, double> gauges;
+};
+
+// Observes the milliseconds between its construction and destruction.
+class MetricTimer {
+public:
+  explicit MetricTimer(MetricHistogram &histogram);
+  virtual ~MetricTimer();
+
+private:
+  MetricHistogram &histogram;
+  std::chrono::steady_clock::time_point start;
+};
+
+#define METRIC_CONCAT_INNER(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_INNER(a, b)
+
+#ifdef ERASER_METRICS
+// the registry lookup happens once per call site
+#define metricCount(name, amount)                                              \
+  do {                                                                         \
+    static MetricCounter &metricCounter = Metrics::instance().counter(name);   \
+    metricCounter.value.fetch_add((amount), std::memory_order_relaxed);        \
+  } while (false)
+#define metricObserve(name, value)                                             \
+  do {                                                                         \
+    static MetricHistogram &metricHistogram =                                  \
+        Metrics::instance().histogram(name);                                   \
+    Metrics::instance().observe(metricHistogram, (value));                     \
+  } while (false)
+#define metricTimer(name)                                                      \
+  static MetricHistogram &METRIC_CONCAT(metricHistogram, __LINE__) =           \
+      Metrics::instance().histogram(name);                                     \
+  MetricTimer METRIC_CONCAT(metricTimer, __LINE__)(                            \
+      METRIC_CONCAT(metricHistogram, __LINE__))
+#else
+#define metricCount(name, amount)                                              \
+  do {                                                                         \
+  } while (false)
+#define metricObserve(name, value)                                             \
+  do {                                                                         \
+  } while (false)
+#define metricTimer(name)                                                      \
+  do {                                                                         \
+  } while (false)
+#endif
@@ -20,7 +20,9 @@
 #include "unlock_node.h"
 #include "write_node.h"
 #include <clang-c/Index.h>
+#include <cstdint>
 #include <iostream>
+#include <map>
 #include <set>
 #include <unordered_map>
 #include <vector>
@@ -48,6 +50,23 @@ struct VariableInfo {
   bool isAtomic;
 };
 
+struct CursorHash {
+  size_t operator()(const CXCursor &cursor) const {
+    return clang_hashCursor(cursor);
+  }
+};
+
+struct CursorEqual {
+  bool operator()(const CXCursor &a, const CXCursor &b) const {
+    return clang_equalCursors(a, b);
+  }
+};
+
+struct SeenFile {
+  uint64_t contentHash;
+  bool updatedCallGraph;
+};
+
 struct VisitorData {
   unsigned int childIndex;
   std::vector<GraphNode *> nodesToAdd;
@@ -67,10 +86,19 @@ public:
   explicit Parser(CallGraph *callGraph, FileIncludes *fileIncludes);
   virtual ~Parser();
 
+  // called before the changed files of a run are parsed
+  void startRun();
   void parseFile(const char *fileName, bool fileChanged = false);
   std::vector<std::string> getFunctions();
 
+  // contents parsed in place of the file on disk until removed, e.g. an
+  // unsaved editor buffer
+  void setUnsavedFile(const std::string &fileName, const std::string &contents);
+  void removeUnsavedFile(const std::string &fileName);
+  bool hasUnsavedFile(const std::string &fileName);
+
 private:
+  std::map<std::string, std::string> unsavedFiles;
   FileIncludes *fileIncludes;
   std::string fileNameString;
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+#include "call_graph.h"
+#include "function_cumulative_locksets.h"
+#include "lockset_table.h"
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// Writes races as JSON lines while phase 3 runs instead of after it. A race of
+// a root is a shared modified variable of the root's phase 1 summary whose
+// cumulative lockset under the root's test is empty. Phase 1 is final by the
+// time phase 3 starts, and cumulative locksets are only ever intersected on
+// the way up the call graph, so a variable is confirmed as soon as any
+// function reachable from the root gets an empty cumulative lockset for it,
+// as long as the root itself is recomputed later in the same ordering. The
+// rest of a root's races are written once the root's own lockset is final.
+//
+// Only facts of this run confirm a race early: functions that are stale in
+// it are left out, along with the functions only reachable through them.
+// Should the root's final lockset still disagree with an early race, a
+// retract line withdraws it, so the races left in the stream are always those
+// detected afterwards.
+class RaceReporter {
+public:
+  explicit RaceReporter(std::ostream *stream, CallGraph *callGraph,
+                        FunctionCumulativeLocksets *functionCumulativeLocksets,
+                        LocksetTable *locksetTable);
+  virtual ~RaceReporter() = default;
+
+  // called by phase 3 with its bottom up ordering before it visits anything
+  void startPhase(const std::set<std::string> &roots,
+                  const std::vector<std::string> &ordering);
+  // called after every function of the ordering, data is null when the
+  // function was skipped
+  void functionFinished(const std::string &funcName,
+                        const FunctionCumulativeData *data);
+  // writes the races of roots not finished yet and a closing summary line
+  void finishPhase();
+  int getRacesReported();
+
+private:
+  std::ostream *stream;
+  CallGraph *callGraph;
+  FunctionCumulativeLocksets *functionCumulativeLocksets;
+  LocksetTable *locksetTable;
+  std::chrono::steady_clock::time_point startTime;
+  std::set<std::string> pendingRoots = {};
+  // roots deleted in this run, they have no races once it finishes
+  std::set<std::string> staleRoots = {};
+  // only for roots visited later in the ordering
+  std::map<std::string, std::set<std::string>> reachable = {};
+  std::map<std::string, std::set<std::string>> sharedModified = {};
+  std::map<std::string, std::set<std::string>> reported = {};
+  std::set<std::string> variablesReported = {};
+
+  void finishRoot(const std::string &root);
+  void report(const std::string &root, const std::string &varName,
+              const std::string &confirmedBy);
+  void retract(const std::string &root, const std::string &varName);
+  long long elapsedMs();
+};
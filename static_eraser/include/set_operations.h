@@ -1,6 +1,7 @@
 // CREDIT: https://stackoverflow.com/questions/13448064/how-to-find-the-intersection-of-two-stl-sets
 
 #pragma once
+#include "metrics.h"
 #include <algorithm>
 #include <iterator>
 #include <set>
@@ -8,6 +9,7 @@
 template <class T, class CMP = std::less<T>, class ALLOC = std::allocator<T>>
 std::set<T, CMP, ALLOC> operator*(const std::set<T, CMP, ALLOC> &s1,
                                   const std::set<T, CMP, ALLOC> &s2) {
+  metricCount("set_operations", 1);
   std::set<T, CMP, ALLOC> s;
   std::set_intersection(s1.begin(), s1.end(), s2.begin(), s2.end(),
                         std::inserter(s, s.begin()));
@@ -17,6 +19,7 @@ std::set<T, CMP, ALLOC> operator*(const std::set<T, CMP, ALLOC> &s1,
 template <class T, class CMP = std::less<T>, class ALLOC = std::allocator<T>>
 std::set<T, CMP, ALLOC> operator+(const std::set<T, CMP, ALLOC> &s1,
                                   const std::set<T, CMP, ALLOC> &s2) {
+  metricCount("set_operations", 1);
   std::set<T, CMP, ALLOC> s;
   std::set_union(s1.begin(), s1.end(), s2.begin(), s2.end(),
                  std::inserter(s, s.begin()));
@@ -26,6 +29,7 @@ std::set<T, CMP, ALLOC> operator+(const std::set<T, CMP, ALLOC> &s1,
 template <class T, class CMP = std::less<T>, class ALLOC = std::allocator<T>>
 std::set<T, CMP, ALLOC> operator-(const std::set<T, CMP, ALLOC> &s1,
                                   const std::set<T, CMP, ALLOC> &s2) {
+  metricCount("set_operations", 1);
   std::set<T, CMP, ALLOC> s;
   std::set_difference(s1.begin(), s1.end(), s2.begin(), s2.end(),
                       std::inserter(s, s.begin()));
@@ -35,6 +39,7 @@ std::set<T, CMP, ALLOC> operator-(const std::set<T, CMP, ALLOC> &s1,
 template <class T, class CMP = std::less<T>, class ALLOC = std::allocator<T>>
 std::set<T, CMP, ALLOC> &operator*=(std::set<T, CMP, ALLOC> &s1,
                                     const std::set<T, CMP, ALLOC> &s2) {
+  metricCount("set_operations", 1);
   auto iter1 = s1.begin();
   for (auto iter2 = s2.begin(); iter1 != s1.end() && iter2 != s2.end();) {
     if (*iter1 < *iter2)
@@ -53,6 +58,7 @@ std::set<T, CMP, ALLOC> &operator*=(std::set<T, CMP, ALLOC> &s1,
 template <class T, class CMP = std::less<T>, class ALLOC = std::allocator<T>>
 std::set<T, CMP, ALLOC> &operator+=(std::set<T, CMP, ALLOC> &s1,
                                     const std::set<T, CMP, ALLOC> &s2) {
+  metricCount("set_operations", 1);
   s1.insert(s2.begin(), s2.end());
   return s1;
 }
@@ -60,6 +66,7 @@ std::set<T, CMP, ALLOC> &operator+=(std::set<T, CMP, ALLOC> &s1,
 template <class T, class CMP = std::less<T>, class ALLOC = std::allocator<T>>
 std::set<T, CMP, ALLOC> &operator-=(std::set<T, CMP, ALLOC> &s1,
                                     const std::set<T, CMP, ALLOC> &s2) {
+  metricCount("set_operations", 1);
   auto iter1 = s1.begin();
   for (auto iter2 = s2.begin(); iter1 != s1.end() && iter2 != s2.end();) {
     if (*iter1 < *iter2)
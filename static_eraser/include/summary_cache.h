@@ -0,0 +1,42 @@
+#pragma once
+#include "eraser_sets.h"
+#include <set>
+#include <string>
+#include <vector>
+
+// Everything phase 1 records for a function besides its CFG
+struct CachedSummary {
+  EraserSets sets = EraserSets::defaultValue;
+  std::set<VarId> reads = {};
+  std::set<VarId> writes = {};
+  std::set<std::string> recursiveUnlocks = {};
+  // eraserIgnoreOn of every node of the CFG, in id order
+  std::vector<bool> ignoreFlags = {};
+};
+
+// Content addressed store of phase 1 summaries, one file per key under a
+// directory that any number of runs may share, for example a mount of a file
+// server. Entries are written to a temporary file and renamed into place, so
+// concurrent runs never read a partial entry.
+class SummaryCache {
+public:
+  explicit SummaryCache(std::string directory);
+  virtual ~SummaryCache() = default;
+
+  // the variables of the loaded sets are interned into varTable, and those of
+  // the stored sets are named by it
+  bool load(const std::string &key, CachedSummary &summary,
+            VarTable &varTable);
+  void store(const std::string &key, const CachedSummary &summary,
+             const VarTable &varTable);
+
+  // canonical text of the sets, equal sets give equal text whatever the ids
+  // of their variables
+  static std::string describe(const EraserSets &sets,
+                              const VarTable &varTable);
+
+private:
+  std::string directory;
+
+  std::string getPath(const std::string &key);
+};
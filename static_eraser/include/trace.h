@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// escapes a string for a JSON string literal
+std::string escapeJson(const std::string &value);
+
+struct TraceEvent {
+  std::string category;
+  std::string name;
+  std::string detail;
+  long long start;
+  long long duration;
+  int thread;
+};
+
+// Collects spans in memory and writes them as Chrome trace-event JSON, which
+// Perfetto and chrome://tracing can open. Tracing is off until start is
+// called, spans created before that are dropped. Every thread that records a
+// span gets its own track.
+class Tracer {
+public:
+  static Tracer &instance();
+
+  void start(const std::string &path);
+  bool isEnabled();
+  // microseconds since start was called
+  long long now();
+  void addSpan(const std::string &category, const std::string &name,
+               const std::string &detail, long long start, long long duration);
+  // writes the trace to the path given to start and stops tracing
+  bool finish();
+  void write(std::ostream &stream);
+
+private:
+  explicit Tracer() = default;
+  int threadId();
+
+  std::atomic<bool> enabled{false};
+  std::atomic<int> nextThreadId{1};
+  std::mutex mutex;
+  std::string path;
+  std::chrono::steady_clock::time_point origin;
+  std::vector<TraceEvent> events;
+  std::vector<int> threads;
+};
+
+// Records a span from its construction to its destruction, does nothing when
+// tracing is off.
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *category, const std::string &name,
+                     const std::string &detail = "");
+  virtual ~TraceSpan();
+
+private:
+  bool active;
+  const char *category;
+  std::string name;
+  std::string detail;
+  long long start = 0;
+};
@@ -0,0 +1,281 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Eraser state machine state of a single variable. The states are exclusive
+// apart from a few combinations the transfer functions can produce (e.g.
+// external shared and internal read), so each state is one bit of a mask
+// rather than one enum value.
+typedef uint8_t VarStateMask;
+
+enum VarState : VarStateMask {
+  VAR_EXTERNAL_READ = 1 << 0,
+  VAR_INTERNAL_READ = 1 << 1,
+  VAR_EXTERNAL_WRITE = 1 << 2,
+  VAR_INTERNAL_WRITE = 1 << 3,
+  VAR_INTERNAL_SHARED = 1 << 4,
+  VAR_EXTERNAL_SHARED = 1 << 5,
+  VAR_SHARED_MODIFIED = 1 << 6,
+  // transition input only: the variable has a write queued by a thread
+  VAR_QUEUED_WRITE = 1 << 7
+};
+
+constexpr VarStateMask VAR_READS = VAR_EXTERNAL_READ | VAR_INTERNAL_READ;
+constexpr VarStateMask VAR_SHARED = VAR_INTERNAL_SHARED | VAR_EXTERNAL_SHARED;
+constexpr VarStateMask VAR_STATES = (1 << 7) - 1;
+
+constexpr VarStateMask readTransition(VarStateMask input) {
+  VarStateMask state = input & VAR_STATES;
+  if (state & VAR_SHARED_MODIFIED) {
+    return state;
+  }
+  if (input & VAR_QUEUED_WRITE) {
+    return VAR_SHARED_MODIFIED;
+  }
+  if (state & (VAR_EXTERNAL_READ | VAR_EXTERNAL_WRITE)) {
+    return (state | VAR_EXTERNAL_SHARED) &
+           ~(VAR_EXTERNAL_READ | VAR_EXTERNAL_WRITE);
+  }
+  if ((state & VAR_SHARED) != VAR_SHARED) {
+    return state | VAR_INTERNAL_READ;
+  }
+  return state;
+}
+
+constexpr VarStateMask writeTransition(VarStateMask input) {
+  VarStateMask state = input & VAR_STATES;
+  if (state & VAR_SHARED_MODIFIED) {
+    return state;
+  }
+  if (input & (VAR_QUEUED_WRITE | VAR_EXTERNAL_READ | VAR_EXTERNAL_WRITE |
+               VAR_SHARED)) {
+    return VAR_SHARED_MODIFIED;
+  }
+  return state | VAR_INTERNAL_WRITE;
+}
+
+template <VarStateMask (*transition)(VarStateMask)>
+constexpr std::array<VarStateMask, 256> createTransitionTable() {
+  std::array<VarStateMask, 256> table = {};
+  for (int input = 0; input < 256; input++) {
+    table[input] = transition(input);
+  }
+  return table;
+}
+
+// indexed by the current state, plus VAR_QUEUED_WRITE if a write is queued
+inline constexpr std::array<VarStateMask, 256> readTable =
+    createTransitionTable<readTransition>();
+inline constexpr std::array<VarStateMask, 256> writeTable =
+    createTransitionTable<writeTransition>();
+
+// a: caller state, b: callee state, both with VAR_QUEUED_WRITE if queued
+constexpr VarStateMask functionCallTransition(VarStateMask a, VarStateMask b) {
+  VarStateMask both = a | b;
+  bool aExternalWrites =
+      a & (VAR_EXTERNAL_WRITE | VAR_QUEUED_WRITE | VAR_EXTERNAL_SHARED);
+  bool bExternalWrites =
+      b & (VAR_EXTERNAL_WRITE | VAR_QUEUED_WRITE | VAR_EXTERNAL_SHARED);
+  bool aInternalWrites = a & (VAR_INTERNAL_WRITE | VAR_INTERNAL_SHARED);
+  bool bInternalWrites = b & (VAR_INTERNAL_WRITE | VAR_INTERNAL_SHARED);
+  bool aAccesses = (a & VAR_READS) || aExternalWrites || aInternalWrites;
+  bool bWrites = bExternalWrites || bInternalWrites;
+
+  bool sharedModified =
+      (both & VAR_SHARED_MODIFIED) || (aAccesses && bExternalWrites) ||
+      ((aExternalWrites || (a & (VAR_EXTERNAL_READ | VAR_SHARED))) && bWrites);
+  bool internalShared =
+      (both & VAR_INTERNAL_SHARED) ||
+      ((aInternalWrites || bInternalWrites) &&
+       (aExternalWrites || bExternalWrites || (both & VAR_EXTERNAL_READ)));
+  bool externalShared =
+      (both & VAR_EXTERNAL_SHARED) ||
+      ((aExternalWrites || bExternalWrites) &&
+       (both & (VAR_INTERNAL_WRITE | VAR_INTERNAL_READ)));
+  if (internalShared && externalShared) {
+    internalShared = false;
+    externalShared = false;
+    sharedModified = true;
+  }
+
+  VarStateMask result = both & VAR_EXTERNAL_WRITE;
+  if (sharedModified) {
+    return result | VAR_SHARED_MODIFIED;
+  }
+  if (internalShared || externalShared) {
+    return result | (internalShared ? VAR_INTERNAL_SHARED : 0) |
+           (externalShared ? VAR_EXTERNAL_SHARED : 0);
+  }
+  return result | (both & (VAR_READS | VAR_INTERNAL_WRITE));
+}
+
+// a: creator state, b: thread function state, both with VAR_QUEUED_WRITE if
+// queued
+constexpr VarStateMask threadCreateTransition(VarStateMask a, VarStateMask b) {
+  VarStateMask accesses = VAR_READS | VAR_EXTERNAL_WRITE | VAR_INTERNAL_WRITE |
+                          VAR_QUEUED_WRITE | VAR_SHARED;
+  bool aAccesses = a & accesses;
+  bool bAccesses = b & accesses;
+  bool bWrites = b & (accesses & ~VAR_READS);
+
+  bool sharedModified =
+      ((a | b) & VAR_SHARED_MODIFIED) || (aAccesses && bWrites);
+  bool externalShared = sharedModified || (a & VAR_EXTERNAL_SHARED) ||
+                        (b & VAR_SHARED) || (aAccesses && bAccesses);
+
+  VarStateMask result = a & VAR_INTERNAL_SHARED;
+  if (sharedModified) {
+    return result | VAR_SHARED_MODIFIED;
+  }
+  if (externalShared) {
+    return result | VAR_EXTERNAL_SHARED;
+  }
+  if (result) {
+    return result;
+  }
+  return (a & (VAR_READS | VAR_EXTERNAL_WRITE | VAR_INTERNAL_WRITE)) |
+         (b & (VAR_EXTERNAL_READ | VAR_EXTERNAL_WRITE)) |
+         ((b & VAR_INTERNAL_READ) ? VAR_EXTERNAL_READ : 0) |
+         ((b & VAR_INTERNAL_WRITE) ? VAR_EXTERNAL_WRITE : 0);
+}
+
+// the writes a thread function queues on its creator
+constexpr bool threadWrites(VarStateMask b) {
+  return b & (VAR_EXTERNAL_WRITE | VAR_INTERNAL_WRITE | VAR_QUEUED_WRITE |
+              VAR_SHARED);
+}
+
+// join of two control flow paths
+constexpr VarStateMask combineTransition(VarStateMask a, VarStateMask b) {
+  VarStateMask both = a | b;
+  if (both & VAR_SHARED_MODIFIED) {
+    return VAR_SHARED_MODIFIED | (a & VAR_SHARED);
+  }
+  if (both & VAR_SHARED) {
+    return both & VAR_SHARED;
+  }
+  return both;
+}
+
+// a: recursive function start state, b: state at a recursive thread create
+constexpr VarStateMask recursiveThreadTransition(VarStateMask a,
+                                                 VarStateMask b) {
+  VarStateMask result = a & (VAR_INTERNAL_READ | VAR_INTERNAL_WRITE |
+                             VAR_INTERNAL_SHARED);
+  if ((a & VAR_EXTERNAL_SHARED) || (b & VAR_SHARED)) {
+    result |= VAR_EXTERNAL_SHARED;
+  }
+  if ((a | b) & VAR_SHARED_MODIFIED) {
+    return result | VAR_SHARED_MODIFIED;
+  }
+  return result | (a & (VAR_EXTERNAL_READ | VAR_EXTERNAL_WRITE)) |
+         ((b & VAR_READS) ? VAR_EXTERNAL_READ : 0) |
+         ((b & (VAR_EXTERNAL_WRITE | VAR_INTERNAL_WRITE)) ? VAR_EXTERNAL_WRITE
+                                                          : 0);
+}
+
+typedef uint32_t VarId;
+
+// Numbers the variables of one function densely from 0, in the order they are
+// first seen, so that the state of a variable is found by indexing a vector
+// rather than by comparing names. Each function has its own table, holding
+// the variables of its CFG and of the summaries of its callees.
+class VarTable {
+public:
+  VarId intern(const std::string &varName) {
+    auto it = ids.find(varName);
+    if (it != ids.end()) {
+      return it->second;
+    }
+    VarId id = names.size();
+    names.push_back(varName);
+    ids.insert({varName, id});
+    return id;
+  }
+
+  const std::string &getName(VarId id) const { return names[id]; }
+
+  size_t size() const { return names.size(); }
+
+  // ids in the order of their names, so that what is stored or hashed does
+  // not depend on the order the variables were interned in
+  template <typename VarIds>
+  std::vector<VarId> sortByName(const VarIds &varIds) const {
+    std::vector<VarId> sorted(varIds.begin(), varIds.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [&](VarId a, VarId b) { return names[a] < names[b]; });
+    return sorted;
+  }
+
+private:
+  std::vector<std::string> names;
+  std::unordered_map<std::string, VarId> ids;
+};
+
+// VarId -> state, a dense array over the ids of one VarTable. Ids past the end
+// of the array are in no state.
+class VarStates {
+public:
+  VarStateMask get(VarId id) const {
+    return id < states.size() ? states[id] : 0;
+  }
+
+  void set(VarId id, VarStateMask state) {
+    if (id >= states.size()) {
+      if (state == 0) {
+        return;
+      }
+      states.resize(id + 1, 0);
+    }
+    count += (state != 0) - (states[id] != 0);
+    states[id] = state;
+  }
+
+  void add(VarId id, VarStateMask state) { set(id, get(id) | state); }
+
+  // the number of variables in some state
+  size_t size() const { return count; }
+
+  // the variables in some state
+  std::vector<VarId> getVars() const {
+    std::vector<VarId> varIds;
+    for (VarId id = 0; id < states.size(); id++) {
+      if (states[id] != 0) {
+        varIds.push_back(id);
+      }
+    }
+    return varIds;
+  }
+
+  // transition(id, a, b) is applied to every variable, with a and b its
+  // states in this and other. It must map two variables in no state to no
+  // state, so only the ids below end and below the end of either array are
+  // visited.
+  template <typename Transition>
+  void merge(const VarStates &other, size_t end, Transition transition) {
+    end = std::max({end, states.size(), other.states.size()});
+    for (VarId id = 0; id < end; id++) {
+      set(id, transition(id, get(id), other.get(id)));
+    }
+  }
+
+  // arrays of different lengths are equal if the longer one only adds
+  // variables in no state
+  bool operator==(const VarStates &other) const {
+    if (count != other.count) {
+      return false;
+    }
+    size_t common = std::min(states.size(), other.states.size());
+    return std::equal(states.begin(), states.begin() + common,
+                      other.states.begin());
+  }
+
+private:
+  std::vector<VarStateMask> states;
+  size_t count = 0;
+};
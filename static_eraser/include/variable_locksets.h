@@ -1,10 +1,12 @@
 #pragma once
 #include "break_node.h"
 #include "call_graph.h"
+#include "checkpoints.h"
 #include "continue_node.h"
 #include "endif_node.h"
 #include "endwhile_node.h"
 #include "eraser_sets.h"
+#include "function_budget.h"
 #include "function_call_node.h"
 #include "function_eraser_sets.h"
 #include "function_variable_locksets.h"
@@ -29,8 +31,23 @@ public:
   virtual ~VariableLocksets() = default;
 
   void updateLocksets();
+  // the top down ordering of the functions whose inputs may have changed
+  std::vector<std::string> getOrdering();
+  // visits the functions of the ordering that need it, from the checkpointed
+  // position when checkpoints are set
+  void visitFunctions(const std::vector<std::string> &ordering);
+  void setBudget(const FunctionBudget &budget);
+  void setCheckpoints(Checkpoints *checkpoints);
+  int getFunctionsVisited();
+  // functions whose dataflow ran out of budget under some test
+  std::vector<std::string> getWidenedFunctions();
 
 private:
+  int functionsVisited = 0;
+  FunctionBudget budget;
+  Checkpoints *checkpoints = nullptr;
+  bool widened;
+  std::vector<std::string> widenedFunctions = {};
   CallGraph *callGraph;
   Parser *parser;
   FunctionVariableLocksets *functionVariableLocksets;
@@ -42,9 +59,14 @@ private:
 
   std::string currFunc;
   std::string currTest;
-  VariableLocks variableLocksets;
+  std::string currCfgHash;
+  std::set<std::string> currRecursiveUnlocks;
+  std::unordered_map<std::string, std::set<std::string>> variableLocksets;
   std::unordered_map<std::string, std::set<std::string>> funcCallLocksets;
   std::unordered_map<GraphNode *, std::set<std::string>> nodeLocks;
+  // locks removed from nodeLocks since the node was last handled, for every
+  // node that has been handled at least once
+  std::unordered_map<GraphNode *, std::set<std::string>> nodeRemovedLocks;
 
   bool variableRead(std::string varName, std::set<std::string> &locks);
   bool variableWrite(std::string varName, std::set<std::string> &locks);
@@ -58,6 +80,16 @@ private:
   bool handleNode(WriteNode *node, std::set<std::string> &locks);
   bool handleNode(GraphNode *node, std::set<std::string> &locks);
 
+  void removeVariableLocks(std::string varName,
+                           std::set<std::string> &removedLocks);
+  void handleRemovedLocks(GraphNode *node,
+                          std::set<std::string> &removedLocks);
+  void removeNodeLocks(GraphNode *node, std::set<std::string> &removedLocks);
+
   void addNodeToQueue(GraphNode *startNode, GraphNode *nextNode);
-  void handleFunction(GraphNode *startNode, std::set<std::string> &startLocks);
+  std::string getCfgHash(GraphNode *startNode);
+  void runLinearPass(StartNode *startNode, std::set<std::string> &startLocks);
+  void runDataflow(GraphNode *startNode, std::set<std::string> &startLocks);
+  void widenFunction(StartNode *startNode);
+  void handleFunction(StartNode *startNode, std::set<std::string> &startLocks);
 };
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "analysis_pipeline.h"
+#include "cumulative_locksets.h"
+#include "debug_tools.h"
+#include "delta_lockset.h"
+#include "metrics.h"
+#include "trace.h"
+#include "variable_locksets.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+AnalysisPipeline::AnalysisPipeline(Database *db)
+    : db(db), functionEraserSets(db), callGraph(db), fileIncludes(db),
+      parser(&callGraph, &fileIncludes), functionVariableLocksets(db),
+      functionCumulativeLocksets(db, &functionVariableLocksets),
+      checkpoints(db) {}
+
+FileIncludes *AnalysisPipeline::getFileIncludes() { return &fileIncludes; }
+
+CallGraph *AnalysisPipeline::getCallGraph() { return &callGraph; }
+
+Parser *AnalysisPipeline::getParser() { return &parser; }
+
+LocksetTable *AnalysisPipeline::getLocksetTable() {
+  return functionVariableLocksets.getLocksetTable();
+}
+
+void AnalysisPipeline::setRoots(const std::set<std::string> &roots) {
+  this->roots = roots;
+}
+
+void AnalysisPipeline::setPriorityOrdering(bool priorityOrdering) {
+  this->priorityOrdering = priorityOrdering;
+}
+
+void AnalysisPipeline::setRaceStream(std::ostream *stream) {
+  raceReporter = std::make_unique<RaceReporter>(
+      stream, &callGraph, &functionCumulativeLocksets, getLocksetTable());
+}
+
+void AnalysisPipeline::setFunctionBudget(const FunctionBudget &budget) {
+  functionBudget = budget;
+}
+
+std::set<std::string> AnalysisPipeline::getWidenedFunctions() {
+  return callGraph.getWidenedNodes();
+}
+
+void AnalysisPipeline::setCheckpointInterval(long long intervalMs) {
+  checkpoints.setInterval(intervalMs);
+}
+
+Checkpoints *AnalysisPipeline::getCheckpoints() { return &checkpoints; }
+
+void AnalysisPipeline::setSummaryCache(const std::string &directory) {
+  summaryCache = std::make_unique<SummaryCache>(directory);
+}
+
+void AnalysisPipeline::parseChangedFiles(
+    const std::set<std::string> &changedFiles) {
+  // the summaries of widened functions depend on the budget they ran out
+  // of, so they are analysed again with the budget of this run
+  std::set<std::string> filesToParse = changedFiles;
+  for (const std::string &file : callGraph.getWidenedFiles()) {
+    filesToParse.insert(file);
+  }
+  std::vector<std::string> files(filesToParse.begin(), filesToParse.end());
+  db->beginTransaction("parsing");
+  checkpoints.startRun(files);
+  parseFiles(files);
+}
+
+void AnalysisPipeline::resumeRun() {
+  std::vector<std::string> files = {};
+  db->beginTransaction("parsing");
+  // runs that stopped after parsing have nothing left to parse
+  checkpoints.resumePhase("parsing", files);
+  parseFiles(files);
+}
+
+void AnalysisPipeline::parseFiles(const std::vector<std::string> &files) {
+  metricTimer("parsing_ms");
+  TraceSpan span("pipeline", "parsing");
+  parser.startRun();
+  functionEraserSets.clearCache();
+  functionVariableLocksets.clearCache();
+  debugCout << "Parsing changed files:" << std::endl;
+  for (size_t i = checkpoints.getPosition(); i < files.size(); i++) {
+    const std::string &file = files[i];
+    debugCout << file << std::endl;
+    int parsedFunctions = parser.getFunctions().size();
+    callGraph.markNodesAsStale(file);
+    // deleted files only need their functions marked as stale
+    if (std::filesystem::exists(file) || parser.hasUnsavedFile(file)) {
+      parser.parseFile(file.c_str(), true);
+    }
+    std::vector<std::string> functions = parser.getFunctions();
+    checkpoints.addFunctions(
+        "changed", std::vector<std::string>(
+                       functions.begin() + parsedFunctions, functions.end()));
+    checkpoints.itemFinished(i + 1);
+  }
+  debugCout << std::endl;
+  if (!checkpoints.isPhaseFinished("parsing")) {
+    checkpoints.finishPhase();
+  }
+  db->commitTransaction();
+
+  functions = checkpoints.getFunctions("changed");
+}
+
+// the functions of the ordering that are (or are not) in functions, in the
+// same order
+static std::vector<std::string>
+filterOrdering(const std::vector<std::string> &ordering,
+               const std::vector<std::string> &functions, bool inFunctions) {
+  std::set<std::string> functionSet(functions.begin(), functions.end());
+  std::vector<std::string> filtered;
+  for (const std::string &funcName : ordering) {
+    if ((functionSet.find(funcName) != functionSet.end()) == inFunctions) {
+      filtered.push_back(funcName);
+    }
+  }
+  return filtered;
+}
+
+int AnalysisPipeline::updateDeltaLocksets() {
+  if (checkpoints.isPhaseFinished("phase 1")) {
+    return 0;
+  }
+  metricTimer("phase1_ms");
+  TraceSpan span("pipeline", "phase 1");
+  db->beginTransaction("phase 1");
+  DeltaLockset deltaLockset(&callGraph, &parser, &functionEraserSets);
+  deltaLockset.setBudget(functionBudget);
+  deltaLockset.setCheckpoints(&checkpoints);
+  deltaLockset.setSummaryCache(summaryCache.get());
+  std::vector<std::string> ordering;
+  if (!checkpoints.resumePhase("phase 1", ordering)) {
+    ordering = callGraph.deltaLocksetOrdering(functions);
+    if (priorityOrdering) {
+      // the reachable functions are closed under calls, so they come first
+      // in a bottom up ordering and nothing reachable depends on the rest
+      std::set<std::string> reachable = callGraph.getReachableFunctions(roots);
+      std::vector<std::string> reachableOrdering;
+      std::vector<std::string> deferredFunctions;
+      for (const std::string &funcName : ordering) {
+        if (reachable.find(funcName) != reachable.end()) {
+          reachableOrdering.push_back(funcName);
+        } else {
+          deferredFunctions.push_back(funcName);
+        }
+      }
+      ordering = reachableOrdering;
+      checkpoints.addFunctions("deferred", deferredFunctions);
+    }
+    checkpoints.startPhase("phase 1", ordering);
+  }
+  deltaLockset.visitFunctions(ordering);
+  checkpoints.finishPhase();
+  db->commitTransaction();
+  return deltaLockset.getFunctionsVisited();
+}
+
+int AnalysisPipeline::updateDeferredDeltaLocksets() {
+  int functionsVisited = visitDeferredDeltaLocksets();
+  visitDeferredCumulativeLocksets();
+  return functionsVisited;
+}
+
+int AnalysisPipeline::visitDeferredDeltaLocksets() {
+  if (checkpoints.isPhaseFinished("phase 1 deferred")) {
+    return 0;
+  }
+  std::vector<std::string> ordering;
+  bool resumed = checkpoints.resumePhase("phase 1 deferred", ordering);
+  if (!resumed) {
+    ordering = checkpoints.getFunctions("deferred");
+  }
+  if (ordering.empty()) {
+    return 0;
+  }
+  metricTimer("phase1_deferred_ms");
+  TraceSpan span("pipeline", "phase 1 deferred");
+  db->beginTransaction("phase 1 deferred");
+  DeltaLockset deltaLockset(&callGraph, &parser, &functionEraserSets);
+  deltaLockset.setBudget(functionBudget);
+  deltaLockset.setCheckpoints(&checkpoints);
+  deltaLockset.setSummaryCache(summaryCache.get());
+  if (!resumed) {
+    checkpoints.startPhase("phase 1 deferred", ordering);
+  }
+  deltaLockset.visitFunctions(ordering);
+  checkpoints.finishPhase();
+  db->commitTransaction();
+  return deltaLockset.getFunctionsVisited();
+}
+
+void AnalysisPipeline::visitDeferredCumulativeLocksets() {
+  if (checkpoints.isPhaseFinished("phase 3 deferred")) {
+    return;
+  }
+  CumulativeLocksets cumulativeLocksets(&callGraph,
+                                        &functionCumulativeLocksets);
+  std::vector<std::string> ordering;
+  bool resumed = checkpoints.resumePhase("phase 3 deferred", ordering);
+  if (!resumed) {
+    // the functions phase 3 left out
+    ordering = filterOrdering(cumulativeLocksets.getOrdering(),
+                              checkpoints.getFunctions("deferred"), true);
+  }
+  if (ordering.empty()) {
+    return;
+  }
+  metricTimer("phase3_deferred_ms");
+  TraceSpan span("pipeline", "phase 3 deferred");
+  db->beginTransaction("phase 3 deferred");
+  cumulativeLocksets.setCheckpoints(&checkpoints);
+  if (!resumed) {
+    checkpoints.startPhase("phase 3 deferred", ordering);
+  }
+  cumulativeLocksets.visitFunctions(ordering);
+  checkpoints.finishPhase();
+  db->commitTransaction();
+}
+
+int AnalysisPipeline::updateVariableLocksets() {
+  if (checkpoints.isPhaseFinished("phase 2")) {
+    return 0;
+  }
+  metricTimer("phase2_ms");
+  TraceSpan span("pipeline", "phase 2");
+  db->beginTransaction("phase 2");
+  VariableLocksets variableLocksets(&callGraph, &parser,
+                                    &functionVariableLocksets);
+  variableLocksets.setBudget(functionBudget);
+  variableLocksets.setCheckpoints(&checkpoints);
+  std::vector<std::string> ordering;
+  if (!checkpoints.resumePhase("phase 2", ordering)) {
+    functionVariableLocksets.updateRoots(roots);
+    ordering = variableLocksets.getOrdering();
+    checkpoints.startPhase("phase 2", ordering);
+  }
+  variableLocksets.visitFunctions(ordering);
+  checkpoints.finishPhase();
+  db->commitTransaction();
+  return variableLocksets.getFunctionsVisited();
+}
+
+int AnalysisPipeline::updateCumulativeLocksets() {
+  if (checkpoints.isPhaseFinished("phase 3")) {
+    return 0;
+  }
+  metricTimer("phase3_ms");
+  TraceSpan span("pipeline", "phase 3");
+  db->beginTransaction("phase 3");
+  CumulativeLocksets cumulativeLocksets(&callGraph,
+                                        &functionCumulativeLocksets);
+  cumulativeLocksets.setRaceReporter(raceReporter.get(), roots);
+  cumulativeLocksets.setCheckpoints(&checkpoints);
+  std::vector<std::string> ordering;
+  if (!checkpoints.resumePhase("phase 3", ordering)) {
+    // deferred functions have no phase 1 summary yet, they are visited once
+    // updateDeferredDeltaLocksets has made one
+    ordering = filterOrdering(cumulativeLocksets.getOrdering(),
+                              checkpoints.getFunctions("deferred"), false);
+    checkpoints.startPhase("phase 3", ordering);
+  }
+  cumulativeLocksets.visitFunctions(ordering);
+  checkpoints.finishPhase();
+  db->commitTransaction();
+  return cumulativeLocksets.getFunctionsVisited();
+}
+
+void AnalysisPipeline::markResultsAsOld() {
+  TraceSpan span("pipeline", "mark results as old");
+  db->beginTransaction("mark results as old");
+  functionEraserSets.markFunctionEraserSetsAsOld();
+  functionVariableLocksets.markFunctionVariableLocksetsAsOld();
+  callGraph.deleteStaleNodes();
+  checkpoints.finishRun();
+  db->commitTransaction();
+}
+
+std::map<std::string, std::set<std::string>>
+AnalysisPipeline::detectDataRacesPerRoot() {
+  metricTimer("race_detection_ms");
+  TraceSpan span("pipeline", "race detection");
+  std::vector<std::string> rootList(roots.begin(), roots.end());
+  std::vector<std::set<std::string>> results(rootList.size());
+
+  unsigned int workers = std::min<unsigned int>(
+      std::max(1u, std::thread::hardware_concurrency()), rootList.size());
+  if (workers <= 1) {
+    for (size_t i = 0; i < rootList.size(); i++) {
+      TraceSpan rootSpan("races", rootList[i]);
+      results[i] = functionCumulativeLocksets.detectDataRaces(rootList[i]);
+    }
+  } else {
+    // sqlite connections must not be shared between threads, the workers
+    // only read so they can run alongside each other
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+    for (unsigned int worker = 0; worker < workers; worker++) {
+      threads.emplace_back([&]() {
+        Database workerDb(false, db->getPath());
+        FunctionVariableLocksets workerVariableLocksets(&workerDb);
+        FunctionCumulativeLocksets workerCumulativeLocksets(
+            &workerDb, &workerVariableLocksets);
+        for (size_t i = next++; i < rootList.size(); i = next++) {
+          TraceSpan rootSpan("races", rootList[i]);
+          results[i] = workerCumulativeLocksets.detectDataRaces(rootList[i]);
+        }
+      });
+    }
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+  }
+
+  std::map<std::string, std::set<std::string>> dataRaces;
+  for (size_t i = 0; i < rootList.size(); i++) {
+    dataRaces.insert({rootList[i], results[i]});
+  }
+  return dataRaces;
+}
+
+std::set<std::string> AnalysisPipeline::detectDataRaces() {
+  std::set<std::string> dataRaces;
+  for (const auto &pair : detectDataRacesPerRoot()) {
+    dataRaces.insert(pair.second.begin(), pair.second.end());
+  }
+  return dataRaces;
+}
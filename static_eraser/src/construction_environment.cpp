@@ -1,15 +1,25 @@
 #include "construction_environment.h"
+#include "metrics.h"
+#include <set>
 
 StartNode *ConstructionEnvironment::startNewTree(std::string funcName) {
   currNode = new StartNode(funcName);
   currNode->id = 1;
   currId = 1;
+  hasLoops = false;
+  hasCalls = false;
+  hasEffects = false;
+  events = 0;
   ifStack = {};
   endifListStack = {};
   whileStack = {};
   startwhileStack = {};
   breakListStack = {};
   continueListStack = {};
+  ifEventsStack = {};
+  loopEventsStack = {};
+  loopIfDepthStack = {};
+  sliceRegions = {};
   return (StartNode *)currNode;
 };
 
@@ -17,7 +27,44 @@ void ConstructionEnvironment::setNodeId(GraphNode *node) {
   if (node != nullptr && node->id == 0) {
     currId += 1;
     node->id = currId;
+
+    switch (node->type) {
+    case STARTWHILE:
+      hasLoops = true;
+      break;
+    case FUNCTION_CALL:
+    case THREAD_CREATE:
+      hasCalls = true;
+      hasEffects = true;
+      events++;
+      break;
+    case LOCK:
+    case UNLOCK:
+    case READ:
+    case WRITE:
+    case THREAD_JOIN:
+    case ERASER_IGNORE_ON:
+    case ERASER_IGNORE_OFF:
+      hasEffects = true;
+      events++;
+      break;
+    case RETURN:
+      events++;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+CfgKind ConstructionEnvironment::getCfgKind() {
+  if (hasLoops) {
+    return CFG_GENERAL;
+  }
+  if (!hasEffects) {
+    return CFG_TRIVIAL;
   }
+  return hasCalls ? CFG_GENERAL : CFG_ACYCLIC;
 }
 
 void ConstructionEnvironment::onAdd(GraphNode *node) {
@@ -36,6 +83,7 @@ void ConstructionEnvironment::callOnAdd(GraphNode *node) { onAdd(node); }
 
 void ConstructionEnvironment::onAdd(IfNode *node) {
   ifStack.push_back(node);
+  ifEventsStack.push_back(events);
   endifListStack.push_back(std::vector<BasicNode *>(0));
   callOnAdd(node);
 }
@@ -72,10 +120,17 @@ void ConstructionEnvironment::onAdd(EndifNode *node) {
   } else {
     callOnAdd(node);
   }
+
+  if (ifEventsStack.back() == events) {
+    addSliceRegion(ifNode, nullptr, node);
+  }
+  ifEventsStack.pop_back();
 }
 
 void ConstructionEnvironment::onAdd(StartwhileNode *node) {
   startwhileStack.push_back(node);
+  loopEventsStack.push_back(events);
+  loopIfDepthStack.push_back(ifEventsStack.size());
   if (node->continueReturn == nullptr) {
     continueListStack.push_back(std::vector<ContinueNode *>(0));
   }
@@ -110,15 +165,30 @@ void ConstructionEnvironment::onAdd(EndwhileNode *node) {
   }
   currNode = node;
   setNodeId(node);
+
+  if (loopEventsStack.back() == events) {
+    addSliceRegion(startwhileNode, whileNode, node);
+  }
+  loopEventsStack.pop_back();
+  loopIfDepthStack.pop_back();
+}
+
+void ConstructionEnvironment::onLoopJump() {
+  size_t ifDepth = loopIfDepthStack.empty() ? 0 : loopIfDepthStack.back();
+  for (size_t i = ifDepth; i < ifEventsStack.size(); i++) {
+    ifEventsStack[i] = -1;
+  }
 }
 
 void ConstructionEnvironment::onAdd(BreakNode *node) {
+  onLoopJump();
   callOnAdd(node);
   breakListStack.back().push_back(node);
   currNode = nullptr;
 }
 
 void ConstructionEnvironment::onAdd(ContinueNode *node) {
+  onLoopJump();
   callOnAdd(node);
   GraphNode *continueReturn = startwhileStack.back()->continueReturn;
   if (continueReturn != nullptr) {
@@ -144,4 +214,56 @@ void ConstructionEnvironment::onAdd(ContinueReturnNode *node) {
 void ConstructionEnvironment::onAdd(ReturnNode *node) {
   callOnAdd(node);
   currNode = nullptr;
-}
\ No newline at end of file
+}
+
+// Regions are recorded as they are closed, so any region nested in this one
+// is at the back of the list and is covered by this one.
+void ConstructionEnvironment::addSliceRegion(GraphNode *entry,
+                                             WhileNode *whileNode,
+                                             GraphNode *exit) {
+  while (!sliceRegions.empty() && sliceRegions.back().entry->id > entry->id) {
+    sliceRegions.pop_back();
+  }
+  sliceRegions.push_back({entry, whileNode, exit});
+}
+
+// Replaces the body of every event-free region with the smallest graph that
+// has the same join points: an if whose branches both go straight to the
+// endif, or a loop whose while node goes back to the start while. Joins are
+// kept as combining a state with itself is not always a no-op in phase 1.
+void ConstructionEnvironment::sliceCfg() {
+  int nodesSliced = 0;
+  for (SliceRegion &region : sliceRegions) {
+    std::set<GraphNode *> visited = {region.entry, region.exit};
+    std::vector<GraphNode *> stack = region.entry->getNextNodes();
+    std::vector<GraphNode *> nodes = {};
+    while (!stack.empty()) {
+      GraphNode *node = stack.back();
+      stack.pop_back();
+      if (!visited.insert(node).second) {
+        continue;
+      }
+      if (node != region.whileNode) {
+        nodes.push_back(node);
+      }
+      for (GraphNode *nextNode : node->getNextNodes()) {
+        stack.push_back(nextNode);
+      }
+    }
+
+    if (region.whileNode == nullptr) {
+      IfNode *ifNode = (IfNode *)region.entry;
+      ifNode->ifNode = region.exit;
+      ifNode->elseNode = region.exit;
+    } else {
+      ((StartwhileNode *)region.entry)->next = region.whileNode;
+      region.whileNode->whileNode = region.entry;
+    }
+    for (GraphNode *node : nodes) {
+      delete node;
+    }
+    nodesSliced += nodes.size();
+  }
+  metricCount("cfg_nodes_sliced", nodesSliced);
+  sliceRegions = {};
+}
@@ -1,5 +1,6 @@
 #include "cumulative_locksets.h"
 #include "debug_tools.h"
+#include "trace.h"
 
 CumulativeLocksets::CumulativeLocksets(
     CallGraph *callGraph,
@@ -8,18 +9,55 @@ CumulativeLocksets::CumulativeLocksets(
   this->functionCumulativeLocksets = functionCumulativeLocksets;
 }
 
-void CumulativeLocksets::updateLocksets() {
+void CumulativeLocksets::setRaceReporter(RaceReporter *raceReporter,
+                                         const std::set<std::string> &roots) {
+  this->raceReporter = raceReporter;
+  this->roots = roots;
+}
+
+void CumulativeLocksets::updateLocksets() { visitFunctions(getOrdering()); }
+
+std::vector<std::string> CumulativeLocksets::getOrdering() {
   std::vector<std::string> functions =
       functionCumulativeLocksets->getFunctionsForTesting();
-  std::vector<std::string> ordering =
-      callGraph->deltaLocksetOrdering(functions);
+  return callGraph->deltaLocksetOrdering(functions);
+}
 
-  for (const std::string &funcName : ordering) {
+void CumulativeLocksets::visitFunctions(
+    const std::vector<std::string> &ordering) {
+  if (raceReporter != nullptr) {
+    raceReporter->startPhase(roots, ordering);
+  }
+
+  int start = checkpoints == nullptr ? 0 : checkpoints->getPosition();
+  for (size_t i = start; i < ordering.size(); i++) {
+    const std::string &funcName = ordering[i];
     if (!functionCumulativeLocksets->shouldVisitNode(funcName)) {
       debugCout << "CL SKIPPING " << funcName << std::endl;
+      if (raceReporter != nullptr) {
+        raceReporter->functionFinished(funcName, nullptr);
+      }
       continue;
     }
     debugCout << "CL Looking at " << funcName << std::endl;
-    functionCumulativeLocksets->updateFunctionCumulativeLocksets(funcName);
+    TraceSpan span("phase3", funcName);
+    functionsVisited++;
+    FunctionCumulativeData data =
+        functionCumulativeLocksets->updateFunctionCumulativeLocksets(funcName);
+    if (raceReporter != nullptr) {
+      raceReporter->functionFinished(funcName, &data);
+    }
+    if (checkpoints != nullptr) {
+      checkpoints->itemFinished(i + 1);
+    }
+  }
+  if (raceReporter != nullptr) {
+    raceReporter->finishPhase();
   }
-}
\ No newline at end of file
+}
+
+void CumulativeLocksets::setCheckpoints(Checkpoints *checkpoints) {
+  this->checkpoints = checkpoints;
+}
+
+int CumulativeLocksets::getFunctionsVisited() { return functionsVisited; }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "delta_lockset.h"
+#include "analysis_version.h"
 #include "debug_tools.h"
+#include "fnv_hash.h"
+#include "metrics.h"
+#include "trace.h"
 #include "set_operations.h"
 
 DeltaLockset::DeltaLockset(CallGraph *callGraph, Parser *parser,
@@ -7,53 +11,70 @@ DeltaLockset::DeltaLockset(CallGraph *callGraph, Parser *parser,
     : callGraph(callGraph), parser(parser),
       functionEraserSets(functionEraserSets) {}
 
-void addVarToSM(std::string varName, EraserSets &sets) {
-  sets.sharedModified.insert(varName);
-  sets.queuedWrites.removeVar(varName);
-  sets.internalReads.erase(varName);
-  sets.externalReads.erase(varName);
-  sets.internalWrites.erase(varName);
-  sets.externalWrites.erase(varName);
-  sets.internalShared.erase(varName);
-  sets.externalShared.erase(varName);
+// Numbers the variables of the nodes of the current function and of the sets
+// of its callees once, so that the dataflow only handles ids
+void DeltaLockset::internFunction(StartNode *startNode) {
+  VarTable &varTable = functionEraserSets->getCurrVarTable();
+  auto addCallee = [&](const std::string &functionName) {
+    if (functionName != currFunc &&
+        calleeSets.find(functionName) == calleeSets.end()) {
+      calleeSets.insert(
+          {functionName,
+           functionEraserSets->getEraserSets(functionName, varTable)});
+    }
+  };
+
+  for (GraphNode *node : startNode->getNodesInIdOrder()) {
+    if (auto *readNode = dynamic_cast<ReadNode *>(node)) {
+      nodeVars[node] = varTable.intern(readNode->varName);
+    } else if (auto *writeNode = dynamic_cast<WriteNode *>(node)) {
+      nodeVars[node] = varTable.intern(writeNode->varName);
+    } else if (auto *functionNode = dynamic_cast<FunctionCallNode *>(node)) {
+      addCallee(functionNode->functionName);
+    } else if (auto *threadCreateNode =
+                   dynamic_cast<ThreadCreateNode *>(node)) {
+      nodeVars[node] = varTable.intern(threadCreateNode->varName);
+      addCallee(threadCreateNode->functionName);
+    } else if (auto *threadJoinNode = dynamic_cast<ThreadJoinNode *>(node)) {
+      nodeVars[node] = varTable.intern(threadJoinNode->varName);
+    }
+  }
+}
+
+// recursive calls use the sets of the dataflow itself
+EraserSets *DeltaLockset::getCalleeSets(const std::string &functionName) {
+  if (functionName == currFunc) {
+    return functionEraserSets->getCurrEraserSets();
+  }
+  return &calleeSets[functionName];
 }
 
-bool DeltaLockset::variableRead(std::string varName, EraserSets &sets) {
-  this->functionDirectReads.insert(varName);
-  if (sets.sharedModified.find(varName) != sets.sharedModified.end()) {
+bool DeltaLockset::variableRead(VarId var, EraserSets &sets) {
+  this->functionDirectReads.insert(var);
+  VarStateMask state = sets.vars.get(var);
+  if (state & VAR_SHARED_MODIFIED) {
     return true;
   }
-  std::set<std::string> queuedWrites = sets.queuedWrites.values();
-  if (queuedWrites.find(varName) != queuedWrites.end()) {
-    addVarToSM(varName, sets);
-  } else if (sets.externalReads.find(varName) != sets.externalReads.end() ||
-             sets.externalWrites.find(varName) != sets.externalWrites.end()) {
-    sets.externalShared.insert(varName);
-    sets.externalWrites.erase(varName);
-    sets.externalReads.erase(varName);
-  } else if (sets.externalShared.find(varName) == sets.externalShared.end() ||
-             sets.internalShared.find(varName) == sets.internalShared.end()) {
-    sets.internalReads.insert(varName);
+  if (sets.queuedWrites.containsVar(var)) {
+    state |= VAR_QUEUED_WRITE;
+    sets.queuedWrites.removeVar(var);
   }
+  sets.vars.set(var, readTable[state]);
   return true;
 }
 
-bool DeltaLockset::variableWrite(std::string varName, EraserSets &sets) {
-  this->functionDirectWrites.insert(varName);
-  if (sets.sharedModified.find(varName) != sets.sharedModified.end()) {
+bool DeltaLockset::variableWrite(VarId var, EraserSets &sets) {
+  this->functionDirectWrites.insert(var);
+  VarStateMask state = sets.vars.get(var);
+  if (state & VAR_SHARED_MODIFIED) {
     return true;
   }
-  std::set<std::string> queuedWrites = sets.queuedWrites.values();
-  if (queuedWrites.find(varName) != queuedWrites.end() ||
-      sets.externalWrites.find(varName) != sets.externalWrites.end() ||
-      sets.externalReads.find(varName) != sets.externalReads.end() ||
-      sets.externalShared.find(varName) != sets.externalShared.end() ||
-      sets.internalShared.find(varName) != sets.internalShared.end()) {
-    addVarToSM(varName, sets);
-  } else {
-    sets.internalWrites.insert(varName);
+  if (sets.queuedWrites.containsVar(var)) {
+    state |= VAR_QUEUED_WRITE;
+    sets.queuedWrites.removeVar(var);
   }
-  sets.activeThreads.erase(varName);
+  sets.vars.set(var, writeTable[state]);
+  sets.activeThreads.erase(var);
   return true;
 }
 
@@ -71,6 +92,7 @@ bool DeltaLockset::recursiveFunctionCall(std::string functionName,
     } else {
       functionEraserSets->combineSets(nextSets, sets);
       functionEraserSets->saveRecursiveUnlocks(sets.unlocks);
+      functionRecursiveUnlocks += sets.unlocks;
     }
     if (nextSets != nodeSets[startNode] || !recursive) {
       nodeSets[startNode] = nextSets;
@@ -81,16 +103,18 @@ bool DeltaLockset::recursiveFunctionCall(std::string functionName,
   return false;
 }
 
-void DeltaLockset::threadFinished(std::string varName, EraserSets &sets) {
-  if (sets.activeThreads.find(varName) == sets.activeThreads.end()) {
-    sets.finishedThreads.insert(varName);
+void DeltaLockset::threadFinished(VarId var, EraserSets &sets) {
+  if (!sets.activeThreads.contains(var)) {
+    sets.finishedThreads.insert(var);
   } else {
-    std::set<std::string> tids = sets.activeThreads[varName];
+    const std::set<std::string> &tids = sets.activeThreads.getTids(var);
     for (const std::string &tid : tids) {
-      sets.externalWrites += sets.queuedWrites[tid];
+      for (VarId write : sets.queuedWrites.getWrites(tid)) {
+        sets.vars.add(write, VAR_EXTERNAL_WRITE);
+      }
     }
     sets.queuedWrites -= tids;
-    sets.activeThreads.erase(varName);
+    sets.activeThreads.erase(var);
   }
 }
 
@@ -104,72 +128,39 @@ bool DeltaLockset::handleNode(FunctionCallNode *node, EraserSets &sets) {
   }
 
   EraserSets *s1 = &sets;
-  EraserSets *s2 = functionEraserSets->getEraserSets(functionName);
-  std::set<std::string> s1Shared = s1->externalShared + s1->internalShared;
-  std::set<std::string> s2Shared = s2->externalShared + s2->internalShared;
-  std::set<std::string> s1Reads = s1->externalReads + s1->internalReads;
-
-  std::set<std::string> s1ExternalWrites =
-      s1->externalWrites + s1->queuedWrites.values() + s1->externalShared;
-  std::set<std::string> s1InternalWrites =
-      s1->internalWrites + s1->internalShared;
-  std::set<std::string> s1Writes = s1InternalWrites + s1ExternalWrites;
-  std::set<std::string> s2ExternalWrites =
-      s2->externalWrites + s2->queuedWrites.values() + s2->externalShared;
-  std::set<std::string> s2InternalWrites =
-      s2->internalWrites + s2->internalShared;
-  std::set<std::string> s2Writes = s2InternalWrites + s2ExternalWrites;
-
+  EraserSets *s2 = getCalleeSets(functionName);
   s1->locks -= s2->unlocks;
   s1->locks += s2->locks;
   s1->unlocks -= s2->locks;
   s1->unlocks += s2->unlocks;
 
-  s1->sharedModified +=
-      s2->sharedModified + ((s1Reads + s1Writes) * s2ExternalWrites) +
-      ((s1ExternalWrites + s1->externalReads + s1Shared) * s2Writes);
-
-  s1->internalShared +=
-      s2->internalShared + (s1InternalWrites + s2InternalWrites) *
-                               (s1ExternalWrites + s2ExternalWrites +
-                                s1->externalReads + s2->externalReads);
-
-  s1->externalShared +=
-      s2->externalShared + (s1ExternalWrites + s2ExternalWrites) *
-                               (s1->internalWrites + s2->internalWrites +
-                                s1->internalReads + s2->internalReads);
-
-  std::set<std::string> overlap = s1->internalShared * s1->externalShared;
-  s1->internalShared -= overlap;
-  s1->externalShared -= overlap;
-  s1->sharedModified += overlap;
-
-  std::set<std::string> sOrSm =
-      s1->internalShared + s1->externalShared + s1->sharedModified;
+  // variables with a queued write may be in no state
+  VarId queuedEnd =
+      std::max(s1->queuedWrites.varEnd(), s2->queuedWrites.varEnd());
+  s1->vars.merge(s2->vars, queuedEnd,
+                 [&](VarId var, VarStateMask a, VarStateMask b) {
+                   if (s1->queuedWrites.containsVar(var)) {
+                     a |= VAR_QUEUED_WRITE;
+                   }
+                   if (s2->queuedWrites.containsVar(var)) {
+                     b |= VAR_QUEUED_WRITE;
+                   }
+                   return functionCallTransition(a, b);
+                 });
 
   s1->queuedWrites += s2->queuedWrites;
-  s1->queuedWrites.removeVars(s1->sharedModified);
-  s1->internalReads += s2->internalReads;
-  s1->internalReads -= sOrSm;
-  s1->internalWrites += s2->internalWrites;
-  s1->internalWrites -= sOrSm;
-  s1->externalReads += s2->externalReads;
-  s1->externalReads -= sOrSm;
-  s1->externalWrites += s2->externalWrites;
+  s1->queuedWrites.removeVarsInState(s1->vars, VAR_SHARED_MODIFIED);
 
-  for (const std::string &varName : s2->finishedThreads) {
-    threadFinished(varName, *s1);
+  for (VarId var : s2->finishedThreads) {
+    threadFinished(var, *s1);
   }
-
-  s1->internalShared -= s1->sharedModified;
-  s1->externalShared -= s1->sharedModified;
   return true;
 };
 
 bool DeltaLockset::handleNode(ThreadCreateNode *node, EraserSets &sets) {
-  std::string varName = node->varName;
-  if (node->global && varName != "" && !sets.eraserIgnoreOn) {
-    variableWrite(varName, sets);
+  VarId var = nodeVars[node];
+  if (node->global && node->varName != "" && !sets.eraserIgnoreOn) {
+    variableWrite(var, sets);
   }
   std::string functionName = node->functionName;
   if (recursiveFunctionCall(node->functionName, sets, true)) {
@@ -178,62 +169,45 @@ bool DeltaLockset::handleNode(ThreadCreateNode *node, EraserSets &sets) {
   std::string tid = currFunc + " " + std::to_string(node->id);
 
   EraserSets *s1 = &sets;
-  EraserSets *s2 = functionEraserSets->getEraserSets(functionName);
-  std::set<std::string> s1Shared = s1->externalShared + s1->internalShared;
-  std::set<std::string> s2Shared = s2->externalShared + s2->internalShared;
-  std::set<std::string> s1Reads = s1->externalReads + s1->internalReads;
-  std::set<std::string> s2Reads = s2->externalReads + s2->internalReads;
-  std::set<std::string> s1Writes = s1->externalWrites + s1->internalWrites +
-                                   s1->queuedWrites.values() + s1Shared;
-  std::set<std::string> s2Writes = s2->externalWrites + s2->internalWrites +
-                                   s2->queuedWrites.values() + s2Shared;
-
-  s1->sharedModified += s2->sharedModified + ((s1Reads + s1Writes) * s2Writes);
-
-  s1->externalShared += s2Shared + s1->sharedModified +
-                        ((s1Reads + s1Writes) * (s2Reads + s2Writes));
-
-  s1Shared += s1->externalShared;
-
-  if (s1->queuedWrites.find(tid) == s1->queuedWrites.end()) {
-    s1->queuedWrites.insert({tid, {}});
-  }
-  for (const std::string &write : s2Writes) {
-    s1->queuedWrites[tid].insert(write);
-  }
-  s1->queuedWrites.removeVars(s1->sharedModified);
-
-  s1->internalReads -= s1Shared;
-  s1->internalWrites -= s1Shared;
-  s1->externalReads += s2->externalReads + s2->internalReads;
-  s1->externalReads -= s1Shared;
-  s1->externalWrites += s2->externalWrites + s2->internalWrites;
-  s1->externalWrites -= s1Shared;
-  s1->activeThreads.erase(varName);
+  EraserSets *s2 = getCalleeSets(functionName);
+  std::set<VarId> s2Writes = {};
+
+  VarId queuedEnd =
+      std::max(s1->queuedWrites.varEnd(), s2->queuedWrites.varEnd());
+  s1->vars.merge(s2->vars, queuedEnd,
+                 [&](VarId var, VarStateMask a, VarStateMask b) {
+                   if (s1->queuedWrites.containsVar(var)) {
+                     a |= VAR_QUEUED_WRITE;
+                   }
+                   if (s2->queuedWrites.containsVar(var)) {
+                     b |= VAR_QUEUED_WRITE;
+                   }
+                   if (threadWrites(b)) {
+                     s2Writes.insert(var);
+                   }
+                   return threadCreateTransition(a, b);
+                 });
+
+  for (VarId write : s2Writes) {
+    s1->queuedWrites.insert(tid, write);
+  }
+  s1->queuedWrites.removeVarsInState(s1->vars, VAR_SHARED_MODIFIED);
+
+  s1->activeThreads.erase(var);
   s1->activeThreads -= s2Writes;
   s1->activeThreads += s2->activeThreads;
-  if (varName != "") {
-    if (s1->activeThreads.find(tid) == s1->activeThreads.end()) {
-      s1->activeThreads.insert({varName, {}});
-    }
-    s1->activeThreads[varName] += {tid};
+  if (node->varName != "") {
+    s1->activeThreads.insert(var, tid);
   }
-  s1->externalShared -= s1->sharedModified;
-
-  // If something breaks then try uncommenting the following
-  // std::set<std::string> overlap = s1->internalShared * s1->externalShared;
-  // s1->internalShared -= overlap;
-  // s1->externalShared -= overlap;
-  // s1->sharedModified += overlap;
   return true;
 };
 
 bool DeltaLockset::handleNode(ThreadJoinNode *node, EraserSets &sets) {
-  std::string varName = node->varName;
-  if (node->global && varName != "" && !sets.eraserIgnoreOn) {
-    variableRead(varName, sets);
+  VarId var = nodeVars[node];
+  if (node->global && node->varName != "" && !sets.eraserIgnoreOn) {
+    variableRead(var, sets);
   }
-  threadFinished(varName, sets);
+  threadFinished(var, sets);
   return true;
 };
 
@@ -253,14 +227,14 @@ bool DeltaLockset::handleNode(ReadNode *node, EraserSets &sets) {
   if (sets.eraserIgnoreOn) {
     return true;
   }
-  return variableRead(node->varName, sets);
+  return variableRead(nodeVars[node], sets);
 };
 
 bool DeltaLockset::handleNode(WriteNode *node, EraserSets &sets) {
   if (sets.eraserIgnoreOn) {
     return true;
   }
-  return variableWrite(node->varName, sets);
+  return variableWrite(nodeVars[node], sets);
 };
 
 bool DeltaLockset::handleNode(ReturnNode *node, EraserSets &sets) {
@@ -313,14 +287,36 @@ void DeltaLockset::addNodeToQueue(GraphNode *startNode, GraphNode *nextNode) {
   }
 }
 
-void DeltaLockset::handleFunction(GraphNode *startNode) {
-  functionEraserSets->startNewFunction(currFunc);
+// Every edge of an acyclic CFG goes to a node with a higher id, so in id order
+// each node is handled once, after all of its predecessors.
+void DeltaLockset::runLinearPass(StartNode *startNode) {
+  for (GraphNode *node : startNode->getNodesInIdOrder()) {
+    EraserSets eraserSet = nodeSets[node];
+    for (GraphNode *nextNode : node->getNextNodes()) {
+      EraserSets nextSets = eraserSet;
+      handleNode(nextNode, nextSets);
+      auto it = nodeSets.find(nextNode);
+      if (it == nodeSets.end()) {
+        nodeSets.insert({nextNode, nextSets});
+      } else {
+        functionEraserSets->combineSets(nextSets, it->second);
+        it->second = nextSets;
+      }
+      nextNode->eraserIgnoreOn = nextSets.eraserIgnoreOn;
+    }
+  }
+  metricCount("dl_linear_passes", 1);
+}
+
+void DeltaLockset::runDataflow(GraphNode *startNode) {
   forwardQueue.push(startNode);
-  nodeSets.insert({startNode, EraserSets::defaultValue});
-  nodeSets[startNode].eraserIgnoreOn = false;
   recursive = false;
+  widened = false;
+  BudgetTracker budgetTracker(budget);
   bool started = false;
   int lastId = -1;
+  int pops = 0;
+  int requeues = 0;
   std::set<GraphNode *> recursiveVisit = {startNode};
 
   while (!forwardQueue.empty() || !backwardQueue.empty()) {
@@ -334,6 +330,16 @@ void DeltaLockset::handleFunction(GraphNode *startNode) {
     GraphNode *node = forwardQueue.top();
     EraserSets eraserSet = nodeSets[node];
     forwardQueue.pop();
+    pops++;
+    if (budgetTracker.exceeded(pops, eraserSet.vars.size() +
+                                         eraserSet.locks.size() +
+                                         eraserSet.unlocks.size() +
+                                         eraserSet.finishedThreads.size())) {
+      widened = true;
+      forwardQueue = {};
+      backwardQueue.clear();
+      break;
+    }
     if (node->id == lastId) {
       continue;
     }
@@ -361,6 +367,7 @@ void DeltaLockset::handleFunction(GraphNode *startNode) {
           if (nextSets != nodeSets[nextNode] ||
               (recursive &&
                recursiveVisit.find(nextNode) == recursiveVisit.end())) {
+            requeues++;
             nodeSets[nextNode] = nextSets;
             addNodeToQueue(node, nextNode);
           }
@@ -372,25 +379,212 @@ void DeltaLockset::handleFunction(GraphNode *startNode) {
       }
     }
   }
+  metricCount("dl_worklist_pops", pops);
+  metricCount("dl_worklist_requeues", requeues);
+  metricObserve("dl_worklist_pops_per_function", pops);
+  metricObserve("dl_worklist_requeues_per_function", requeues);
+}
+
+// Stands in for the dataflow of a function that ran out of budget. Every
+// variable the function or its callees touch becomes shared modified, and no
+// lock is held after a call while every lock touched may have been released,
+// so the summary is at least as pessimistic as the fixed point would be.
+void DeltaLockset::widenFunction(StartNode *startNode) {
+  EraserSets sets = EraserSets::defaultValue;
+  sets.eraserIgnoreOn = false;
+  auto addCallee = [&](const std::string &functionName) {
+    if (functionName == currFunc) {
+      return;
+    }
+    EraserSets *s2 = getCalleeSets(functionName);
+    for (VarId var : s2->vars.getVars()) {
+      sets.vars.set(var, VAR_SHARED_MODIFIED);
+    }
+    sets.unlocks += s2->locks;
+    sets.unlocks += s2->unlocks;
+  };
+
+  for (GraphNode *node : startNode->getNodesInIdOrder()) {
+    // the flags of an unfinished dataflow may not hold at the fixed point
+    node->eraserIgnoreOn = false;
+    if (auto *readNode = dynamic_cast<ReadNode *>(node)) {
+      functionDirectReads.insert(nodeVars[readNode]);
+      sets.vars.set(nodeVars[readNode], VAR_SHARED_MODIFIED);
+    } else if (auto *writeNode = dynamic_cast<WriteNode *>(node)) {
+      functionDirectWrites.insert(nodeVars[writeNode]);
+      sets.vars.set(nodeVars[writeNode], VAR_SHARED_MODIFIED);
+    } else if (auto *functionNode = dynamic_cast<FunctionCallNode *>(node)) {
+      addCallee(functionNode->functionName);
+    } else if (auto *threadCreateNode =
+                   dynamic_cast<ThreadCreateNode *>(node)) {
+      if (threadCreateNode->global && threadCreateNode->varName != "") {
+        functionDirectWrites.insert(nodeVars[threadCreateNode]);
+        sets.vars.set(nodeVars[threadCreateNode], VAR_SHARED_MODIFIED);
+      }
+      addCallee(threadCreateNode->functionName);
+    } else if (auto *threadJoinNode = dynamic_cast<ThreadJoinNode *>(node)) {
+      if (threadJoinNode->global && threadJoinNode->varName != "") {
+        functionDirectReads.insert(nodeVars[threadJoinNode]);
+        sets.vars.set(nodeVars[threadJoinNode], VAR_SHARED_MODIFIED);
+      }
+    } else if (auto *lockNode = dynamic_cast<LockNode *>(node)) {
+      sets.unlocks.insert(lockNode->varName);
+    } else if (auto *unlockNode = dynamic_cast<UnlockNode *>(node)) {
+      sets.unlocks.insert(unlockNode->varName);
+    }
+  }
+
+  functionEraserSets->resetCurrEraserSets();
+  functionEraserSets->updateCurrEraserSets(sets);
+  widenedFunctions.push_back(currFunc);
+  callGraph->markNodeAsWidened(currFunc);
+  metricCount("dl_functions_widened", 1);
+}
+
+// FNV-1a, only used to key the summary cache
+static std::string hashString(const std::string &str) {
+  uint64_t hash = fnvHash(str.data(), str.size());
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+  return hex;
+}
+
+// Hashes everything the dataflow depends on: the nodes in id order with their
+// edges, the summary of every callee, the budget and the analysis version.
+// Node ids are numbered per function, so edits elsewhere in the file keep the
+// key.
+std::string DeltaLockset::getSummaryKey(StartNode *startNode) {
+  std::string description =
+      std::to_string(analysisVersion) + "\n" + currFunc + "\n" +
+      std::to_string(budget.maxIterations) + " " +
+      std::to_string(budget.maxMs) + " " +
+      std::to_string(budget.maxStateSize) + "\n";
+  std::set<std::string> callees;
+  for (GraphNode *node : startNode->getNodesInIdOrder()) {
+    description += std::to_string(node->id) + " " + node->getPrintableName();
+    if (auto *functionNode = dynamic_cast<FunctionCallNode *>(node)) {
+      callees.insert(functionNode->functionName);
+    } else if (auto *threadCreateNode =
+                   dynamic_cast<ThreadCreateNode *>(node)) {
+      callees.insert(threadCreateNode->functionName);
+    }
+    description += " ->";
+    for (GraphNode *nextNode : node->getNextNodes()) {
+      description += " " + std::to_string(nextNode->id);
+    }
+    description += "\n";
+  }
+  // recursive calls use the sets of the dataflow itself
+  callees.erase(currFunc);
+  for (const std::string &callee : callees) {
+    const InternedEraserSets &interned =
+        functionEraserSets->getInternedSets(callee);
+    description +=
+        callee + " " +
+        hashString(SummaryCache::describe(interned.sets, interned.varTable)) +
+        "\n";
+  }
+  return hashString(description);
+}
+
+// saves a cached summary the way handleFunction saves a computed one
+bool DeltaLockset::loadSummary(StartNode *startNode,
+                               const std::string &summaryKey) {
+  CachedSummary summary;
+  functionEraserSets->startNewFunction(currFunc);
+  if (!summaryCache->load(summaryKey, summary,
+                          functionEraserSets->getCurrVarTable())) {
+    return false;
+  }
+  std::vector<GraphNode *> nodes = startNode->getNodesInIdOrder();
+  if (nodes.size() != summary.ignoreFlags.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < nodes.size(); i++) {
+    nodes[i]->eraserIgnoreOn = summary.ignoreFlags[i];
+  }
+  functionEraserSets->updateCurrEraserSets(summary.sets);
+  if (!summary.recursiveUnlocks.empty()) {
+    functionEraserSets->saveRecursiveUnlocks(summary.recursiveUnlocks);
+  }
+  functionEraserSets->saveFunctionDirectVariableAccesses(summary.reads,
+                                                         summary.writes);
+  functionEraserSets->saveCurrEraserSets();
+  return true;
+}
+
+void DeltaLockset::storeSummary(StartNode *startNode,
+                                const std::string &summaryKey) {
+  CachedSummary summary;
+  summary.sets = *functionEraserSets->getCurrEraserSets();
+  summary.reads = functionDirectReads;
+  summary.writes = functionDirectWrites;
+  summary.recursiveUnlocks = functionRecursiveUnlocks;
+  for (GraphNode *node : startNode->getNodesInIdOrder()) {
+    summary.ignoreFlags.push_back(node->eraserIgnoreOn);
+  }
+  summaryCache->store(summaryKey, summary,
+                      functionEraserSets->getCurrVarTable());
+}
+
+void DeltaLockset::handleFunction(StartNode *startNode) {
+  // trivial functions share one CFG and cost nothing to summarise
+  std::string summaryKey = "";
+  if (summaryCache != nullptr && startNode->kind != CFG_TRIVIAL) {
+    summaryKey = getSummaryKey(startNode);
+    if (loadSummary(startNode, summaryKey)) {
+      return;
+    }
+  }
+
+  functionEraserSets->startNewFunction(currFunc);
+  internFunction(startNode);
+  nodeSets.insert({startNode, EraserSets::defaultValue});
+  nodeSets[startNode].eraserIgnoreOn = false;
+  widened = false;
+  if (startNode->kind == CFG_TRIVIAL) {
+    // every path reaches a return with the sets unchanged
+    functionEraserSets->updateCurrEraserSets(nodeSets[startNode]);
+    metricCount("dl_trivial_functions", 1);
+  } else if (startNode->kind == CFG_ACYCLIC) {
+    runLinearPass(startNode);
+  } else {
+    runDataflow(startNode);
+    if (widened) {
+      widenFunction(startNode);
+    }
+  }
   functionEraserSets->saveFunctionDirectVariableAccesses(functionDirectReads,
                                                          functionDirectWrites);
   functionEraserSets->saveCurrEraserSets();
+  // a widened summary depends on how long the dataflow ran
+  if (summaryKey != "" && !widened) {
+    storeSummary(startNode, summaryKey);
+  }
 
   functionDirectReads.clear();
   functionDirectWrites.clear();
+  functionRecursiveUnlocks.clear();
   nodeSets.clear();
+  nodeVars.clear();
+  calleeSets.clear();
 }
 
 void DeltaLockset::updateLocksets(std::vector<std::string> changedFunctions) {
-  std::vector<std::string> ordering =
-      callGraph->deltaLocksetOrdering(changedFunctions);
+  visitFunctions(callGraph->deltaLocksetOrdering(changedFunctions));
+}
 
-  for (const std::string &funcName : ordering) {
+void DeltaLockset::visitFunctions(const std::vector<std::string> &ordering) {
+  int start = checkpoints == nullptr ? 0 : checkpoints->getPosition();
+  for (size_t i = start; i < ordering.size(); i++) {
+    const std::string &funcName = ordering[i];
     if (!callGraph->shouldVisitNode(funcName)) {
       debugCout << "DL SKIPPING " << funcName << std::endl;
       continue;
     }
     debugCout << "DL Looking At " << funcName << std::endl;
+    TraceSpan span("phase1", funcName);
+    functionsVisited++;
     currFunc = funcName;
     if (funcCfgs.find(funcName) == funcCfgs.end()) {
       std::string fileName = callGraph->getFilenameFromFuncname(funcName);
@@ -399,7 +593,10 @@ void DeltaLockset::updateLocksets(std::vector<std::string> changedFunctions) {
     handleFunction(funcCfgs[funcName]);
 
     if (false) {
-      EraserSets *sets = functionEraserSets->getEraserSets(funcName);
+      const InternedEraserSets &interned =
+          functionEraserSets->getInternedSets(funcName);
+      const EraserSets *sets = &interned.sets;
+      const VarTable &varTable = interned.varTable;
       std::cout << "Function: " << funcName << std::endl;
       std::cout << "Locks: ";
       for (const std::string &lock : sets->locks) {
@@ -412,72 +609,60 @@ void DeltaLockset::updateLocksets(std::vector<std::string> changedFunctions) {
       }
       std::cout << std::endl;
 
-      std::cout << "External Reads: ";
-      for (const std::string &read : sets->externalReads) {
-        std::cout << read << ", ";
-      }
-      std::cout << std::endl;
-
-      std::cout << "Internal Reads: ";
-      for (const std::string &read : sets->internalReads) {
-        std::cout << read << ", ";
-      }
-      std::cout << std::endl;
-
-      std::cout << "External Writes: ";
-      for (const std::string &write : sets->externalWrites) {
-        std::cout << write << ", ";
-      }
-      std::cout << std::endl;
-
-      std::cout << "Internal Writes: ";
-      for (const std::string &write : sets->internalWrites) {
-        std::cout << write << ", ";
-      }
-      std::cout << std::endl;
-
-      std::cout << "Internal Shared: ";
-      for (const std::string &shared : sets->internalShared) {
-        std::cout << shared << ", ";
-      }
-      std::cout << std::endl;
-
-      std::cout << "External Shared: ";
-      for (const std::string &shared : sets->externalShared) {
-        std::cout << shared << ", ";
-      }
-      std::cout << std::endl;
-
-      std::cout << "Shared Modified: ";
-      for (const std::string &shared : sets->sharedModified) {
-        std::cout << shared << ", ";
+      for (VarId var : varTable.sortByName(sets->vars.getVars())) {
+        std::cout << varTable.getName(var) << ": " << (int)sets->vars.get(var)
+                  << ", ";
       }
       std::cout << std::endl;
 
       std::cout << "Queued Writes: ";
       for (const auto &pair : sets->queuedWrites) {
         std::cout << pair.first << ": ";
-        for (const std::string &write : pair.second) {
-          std::cout << write << ", ";
+        for (VarId write : pair.second) {
+          std::cout << varTable.getName(write) << ", ";
         }
       }
       std::cout << std::endl;
 
       std::cout << "Active Threads: ";
-      for (const auto &pair : sets->activeThreads) {
-        std::cout << pair.first << ": ";
-        for (const std::string &tid : pair.second) {
+      for (VarId var = 0; var < sets->activeThreads.varEnd(); var++) {
+        if (!sets->activeThreads.contains(var)) {
+          continue;
+        }
+        std::cout << varTable.getName(var) << ": ";
+        for (const std::string &tid : sets->activeThreads.getTids(var)) {
           std::cout << tid << ", ";
         }
       }
       std::cout << std::endl;
 
       std::cout << "Finished Threads: ";
-      for (const std::string &tid : sets->finishedThreads) {
-        std::cout << tid << ", ";
+      for (VarId thread : sets->finishedThreads) {
+        std::cout << varTable.getName(thread) << ", ";
       }
       std::cout << std::endl;
       std::cout << std::endl;
     }
+    if (checkpoints != nullptr) {
+      checkpoints->itemFinished(i + 1);
+    }
   }
+}
+
+void DeltaLockset::setBudget(const FunctionBudget &budget) {
+  this->budget = budget;
+}
+
+void DeltaLockset::setCheckpoints(Checkpoints *checkpoints) {
+  this->checkpoints = checkpoints;
+}
+
+void DeltaLockset::setSummaryCache(SummaryCache *summaryCache) {
+  this->summaryCache = summaryCache;
+}
+
+int DeltaLockset::getFunctionsVisited() { return functionsVisited; }
+
+std::vector<std::string> DeltaLockset::getWidenedFunctions() {
+  return widenedFunctions;
 }
\ No newline at end of file
@@ -61,4 +61,22 @@ std::set<std::string> DiffAnalysis::getAllFiles(const std::string &repoPath) {
   }
 
   return allFiles;
-}
\ No newline at end of file
+}
+
+std::vector<std::string>
+DiffAnalysis::getAncestors(const std::string &repoPath,
+                           const std::string &commitHash) {
+  std::string changeDirCmd = "cd " + repoPath + " && ";
+  std::string output =
+      executeCommand(changeDirCmd + "git rev-list " + commitHash);
+
+  std::vector<std::string> ancestors;
+  std::istringstream stream(output);
+  std::string ancestor;
+  while (std::getline(stream, ancestor)) {
+    if (!ancestor.empty()) {
+      ancestors.push_back(ancestor);
+    }
+  }
+  return ancestors;
+}
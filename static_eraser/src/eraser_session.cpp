@@ -0,0 +1,135 @@
+#include "eraser_session.h"
+#include "diff_analysis.h"
+#include "eraser_settings.h"
+#include "set_operations.h"
+#include <chrono>
+#include <filesystem>
+
+// databases of another analysis version cannot be updated incrementally
+static bool needsFreshDatabase(const std::string &dbPath) {
+  if (!std::filesystem::exists(dbPath)) {
+    return true;
+  }
+  Database db(false, dbPath);
+  return !EraserSettings(&db).hasCurrentAnalysisVersion();
+}
+
+EraserSession::EraserSession(const std::string &dbPath, bool fresh)
+    : db(fresh || needsFreshDatabase(dbPath), dbPath), pipeline(&db) {}
+
+void EraserSession::setRoots(const std::set<std::string> &roots) {
+  pipeline.setRoots(roots);
+}
+
+void EraserSession::addSubmittedFile(const std::string &fileName) {
+  submittedFiles.insert(fileName);
+  // files including a header are parsed again with it
+  submittedFiles += pipeline.getFileIncludes()->getChildren(fileName);
+}
+
+void EraserSession::submitDirectory(const std::string &path) {
+  DiffAnalysis diffAnalysis(pipeline.getFileIncludes());
+  for (const std::string &fileName : diffAnalysis.getAllFiles(path)) {
+    submitFile(fileName);
+  }
+}
+
+void EraserSession::submitFile(const std::string &fileName) {
+  pipeline.getParser()->removeUnsavedFile(fileName);
+  addSubmittedFile(fileName);
+}
+
+void EraserSession::submitBuffer(const std::string &fileName,
+                                 const std::string &contents) {
+  pipeline.getParser()->setUnsavedFile(fileName, contents);
+  addSubmittedFile(fileName);
+}
+
+AnalysisResult EraserSession::analyse() {
+  auto startTime = std::chrono::steady_clock::now();
+  AnalysisResult result;
+  result.filesSubmitted = submittedFiles.size();
+
+  pipeline.parseChangedFiles(submittedFiles);
+  submittedFiles = {};
+  result.phase1Functions = pipeline.updateDeltaLocksets();
+  result.phase2Functions = pipeline.updateVariableLocksets();
+  result.phase3Functions = pipeline.updateCumulativeLocksets();
+  pipeline.markResultsAsOld();
+  dataRaces = pipeline.detectDataRacesPerRoot();
+
+  result.durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::steady_clock::now() - startTime)
+                          .count();
+  return result;
+}
+
+std::set<std::string> EraserSession::getDataRaces() {
+  std::set<std::string> result;
+  for (const auto &pair : dataRaces) {
+    result += pair.second;
+  }
+  return result;
+}
+
+std::map<std::string, std::set<std::string>>
+EraserSession::getDataRacesPerRoot() {
+  return dataRaces;
+}
+
+FunctionSummary EraserSession::getFunctionSummary(const std::string &funcName) {
+  FunctionSummary summary = {false, "", {}, {}, {}, {}};
+  std::vector<std::string> params = {funcName};
+  sqlite3_stmt *stmt;
+
+  db.prepareStatement(
+      stmt, "SELECT filename FROM functions_table WHERE funcname = ?;",
+      params);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    summary.found = true;
+    summary.fileName = db.getStringFromStatement(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  if (!summary.found) {
+    return summary;
+  }
+
+  db.prepareStatement(
+      stmt, "SELECT lock, type FROM function_locks WHERE funcname = ?;",
+      params);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    std::string lock = db.getStringFromStatement(stmt, 0);
+    if (db.getStringFromStatement(stmt, 1) == "lock") {
+      summary.locks.insert(lock);
+    } else {
+      summary.unlocks.insert(lock);
+    }
+  }
+  sqlite3_finalize(stmt);
+
+  db.prepareStatement(
+      stmt, "SELECT varname, type FROM function_vars WHERE funcname = ?;",
+      params);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    summary.variableStates[db.getStringFromStatement(stmt, 0)].insert(
+        db.getStringFromStatement(stmt, 1));
+  }
+  sqlite3_finalize(stmt);
+
+  LocksetTable *locksetTable = pipeline.getLocksetTable();
+  db.prepareStatement(stmt,
+                      "SELECT fvl.testname, o.varname, o.lockset_id FROM "
+                      "function_variable_locksets fvl JOIN "
+                      "function_variable_locksets_outputs o ON "
+                      "o.function_variable_locksets_id = fvl.id WHERE "
+                      "fvl.funcname = ?;",
+                      params);
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    LocksetId locksetId = sqlite3_column_int64(stmt, 2);
+    summary.variableLocksets[db.getStringFromStatement(stmt, 0)]
+                            [db.getStringFromStatement(stmt, 1)] =
+        locksetTable->get(locksetId);
+  }
+  sqlite3_finalize(stmt);
+  return summary;
+}
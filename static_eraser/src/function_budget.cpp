@@ -0,0 +1,21 @@
+#include "function_budget.h"
+
+BudgetTracker::BudgetTracker(const FunctionBudget &budget)
+    : budget(budget), start(std::chrono::steady_clock::now()) {}
+
+bool BudgetTracker::exceeded(int iterations, int stateSize) {
+  if (budget.maxIterations > 0 && iterations > budget.maxIterations) {
+    return true;
+  }
+  if (budget.maxStateSize > 0 && stateSize > budget.maxStateSize) {
+    return true;
+  }
+  // reading the clock on every pop would cost more than most pops
+  if (budget.maxMs > 0 && iterations % 64 == 0) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    return elapsed > budget.maxMs;
+  }
+  return false;
+}
@@ -1,21 +1,24 @@
-#include "call_graph.h"
-#include "construction_environment.h"
-#include "cumulative_locksets.h"
+#include "analysis_pipeline.h"
+#include "analysis_snapshot.h"
+#include "analysis_version.h"
+#include "baseline_store.h"
+#include "checkpoints.h"
 #include "database.h"
+#include "database_maintenance.h"
 #include "debug_tools.h"
-#include "delta_lockset.h"
 #include "diff_analysis.h"
 #include "eraser_settings.h"
-#include "file_includes.h"
-#include "function_cumulative_locksets.h"
-#include "function_variable_locksets.h"
 #include "graph_visualizer.h"
-#include "parser.h"
-#include "variable_locksets.h"
+#include "metrics.h"
+#include "set_operations.h"
+#include "sql_profiler.h"
+#include "trace.h"
 #include <chrono>
 #include <clang-c/Index.h>
 #include <filesystem>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <sys/resource.h>
 #include <unordered_map>
 #include <vector>
@@ -44,18 +47,260 @@ bool fileExists(const std::string &filename) {
   return file.good();
 }
 
+// collects the garbage of the database on its own
+int collectGarbage(const std::string &dbPath) {
+  if (!fileExists(dbPath)) {
+    std::cerr << "No database to collect garbage from" << std::endl;
+    return 1;
+  }
+  Database db(false, dbPath);
+  if (!EraserSettings(&db).hasCurrentAnalysisVersion()) {
+    std::cerr << dbPath << " was written with another analysis version, "
+                 "analyse a commit before collecting garbage"
+              << std::endl;
+    return 1;
+  }
+  if (Checkpoints(&db).hasUnfinishedRun()) {
+    std::cerr << "The previous run was interrupted, resume it before "
+                 "collecting garbage"
+              << std::endl;
+    return 1;
+  }
+  DatabaseMaintenance maintenance(&db);
+  maintenance.collectGarbage();
+  maintenance.printReport(std::cout);
+  return 0;
+}
+
+int exportSnapshot(const std::string &path, const std::string &dbPath) {
+  if (!fileExists(dbPath)) {
+    std::cerr << "No database to take a snapshot of" << std::endl;
+    return 1;
+  }
+  Database db(false, dbPath);
+  AnalysisSnapshot snapshot(path);
+  if (!snapshot.write(&db)) {
+    return 1;
+  }
+  std::cout << "Saved the analysis of commit " << snapshot.getCommitHash()
+            << " to " << path << std::endl;
+  return 0;
+}
+
+// source is either a snapshot or a directory of them, in which case the
+// snapshot of the nearest ancestor of HEAD in repoPath is restored
+int importSnapshot(const std::string &source, const std::string &repoPath,
+                   const std::string &dbPath) {
+  auto startTime = std::chrono::high_resolution_clock::now();
+  std::string path = source;
+  if (std::filesystem::is_directory(source)) {
+    std::map<std::string, std::string> snapshotPaths;
+    for (const auto &entry : std::filesystem::directory_iterator(source)) {
+      AnalysisSnapshot snapshot(entry.path().string());
+      if (entry.is_regular_file() && snapshot.readHeader()) {
+        snapshotPaths[snapshot.getCommitHash()] = snapshot.getPath();
+      }
+    }
+    path = "";
+    for (const std::string &commitHash :
+         DiffAnalysis(nullptr).getAncestors(repoPath)) {
+      if (snapshotPaths.count(commitHash) > 0) {
+        path = snapshotPaths[commitHash];
+        break;
+      }
+    }
+    if (path == "") {
+      std::cerr << "No snapshot in " << source << " of an ancestor of HEAD"
+                << std::endl;
+      return 1;
+    }
+  }
+  AnalysisSnapshot snapshot(path);
+  if (!snapshot.restore(dbPath)) {
+    return 1;
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::high_resolution_clock::now() - startTime)
+                      .count();
+  std::cout << "Restored the analysis of commit " << snapshot.getCommitHash()
+            << " from " << path << " in " << duration << "ms" << std::endl;
+  return 0;
+}
+
+int listBaselines() {
+  for (const auto &pair : BaselineStore().getBaselines()) {
+    std::cout << pair.first << " " << pair.second << std::endl;
+  }
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
-  if (argc != 5) {
+  // the standalone commands act on a baseline when it is their last argument
+  std::string dbPath = Database::dbName;
+  if (argc > 2 && std::string(argv[1]).rfind("--", 0) == 0 &&
+      std::string(argv[argc - 1]).rfind("--baseline=", 0) == 0) {
+    std::string baselineName =
+        std::string(argv[argc - 1]).substr(std::string("--baseline=").size());
+    if (!BaselineStore::isValidName(baselineName)) {
+      std::cerr << "Invalid baseline name " << baselineName
+                << ", names cannot be empty or contain / or .." << std::endl;
+      return 1;
+    }
+    dbPath = BaselineStore().getPath(baselineName);
+    argc--;
+  }
+  if (argc == 2 && std::string(argv[1]) == "--baselines") {
+    return listBaselines();
+  }
+  if (argc == 2 && std::string(argv[1]) == "--gc") {
+    return collectGarbage(dbPath);
+  }
+  if (argc == 3 && std::string(argv[1]) == "--export-snapshot") {
+    return exportSnapshot(argv[2], dbPath);
+  }
+  if ((argc == 3 || argc == 4) &&
+      std::string(argv[1]) == "--import-snapshot") {
+    return importSnapshot(argv[2], argc == 4 ? argv[3] : ".", dbPath);
+  }
+  std::string metricsJsonPath;
+  std::string metricsPromPath;
+  std::string tracePath;
+  int sqlProfileTop = 0;
+  std::string sqlProfileCsvPath;
+  std::string streamRacesPath;
+  bool priorityOrdering = false;
+  FunctionBudget functionBudget;
+  bool resume = false;
+  long long checkpointMs = 10000;
+  // garbage is collected after a run once either threshold is crossed
+  std::string summaryCachePath;
+  std::string baselineName;
+  long long gcSizeMb = 0;
+  int gcFreePercent = 0;
+  std::set<std::string> roots = {"main"};
+  bool validOptions = true;
+  for (int i = 5; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--metrics-json=", 0) == 0) {
+      metricsJsonPath = arg.substr(std::string("--metrics-json=").size());
+    } else if (arg.rfind("--metrics-prom=", 0) == 0) {
+      metricsPromPath = arg.substr(std::string("--metrics-prom=").size());
+    } else if (arg.rfind("--trace=", 0) == 0) {
+      tracePath = arg.substr(std::string("--trace=").size());
+    } else if (arg.rfind("--roots=", 0) == 0) {
+      roots = {};
+      std::istringstream rootList(arg.substr(std::string("--roots=").size()));
+      std::string root;
+      while (std::getline(rootList, root, ',')) {
+        if (!root.empty()) {
+          roots.insert(root);
+        }
+      }
+      validOptions = validOptions && !roots.empty();
+    } else if (arg == "--sql-profile") {
+      sqlProfileTop = 20;
+    } else if (arg.rfind("--sql-profile=", 0) == 0) {
+      sqlProfileTop =
+          std::stoi(arg.substr(std::string("--sql-profile=").size()));
+    } else if (arg.rfind("--sql-profile-csv=", 0) == 0) {
+      sqlProfileCsvPath = arg.substr(std::string("--sql-profile-csv=").size());
+    } else if (arg.rfind("--stream-races=", 0) == 0) {
+      streamRacesPath = arg.substr(std::string("--stream-races=").size());
+    } else if (arg == "--priority") {
+      priorityOrdering = true;
+    } else if (arg.rfind("--budget-iterations=", 0) == 0) {
+      functionBudget.maxIterations =
+          std::stoi(arg.substr(std::string("--budget-iterations=").size()));
+    } else if (arg.rfind("--budget-ms=", 0) == 0) {
+      functionBudget.maxMs =
+          std::stoll(arg.substr(std::string("--budget-ms=").size()));
+    } else if (arg.rfind("--budget-state=", 0) == 0) {
+      functionBudget.maxStateSize =
+          std::stoi(arg.substr(std::string("--budget-state=").size()));
+    } else if (arg == "--resume") {
+      resume = true;
+    } else if (arg.rfind("--checkpoint-ms=", 0) == 0) {
+      checkpointMs =
+          std::stoll(arg.substr(std::string("--checkpoint-ms=").size()));
+    } else if (arg.rfind("--baseline=", 0) == 0) {
+      baselineName = arg.substr(std::string("--baseline=").size());
+      validOptions = validOptions && !baselineName.empty();
+    } else if (arg.rfind("--summary-cache=", 0) == 0) {
+      summaryCachePath = arg.substr(std::string("--summary-cache=").size());
+    } else if (arg.rfind("--gc-size-mb=", 0) == 0) {
+      gcSizeMb = std::stoll(arg.substr(std::string("--gc-size-mb=").size()));
+    } else if (arg.rfind("--gc-free-percent=", 0) == 0) {
+      gcFreePercent =
+          std::stoi(arg.substr(std::string("--gc-free-percent=").size()));
+    } else {
+      validOptions = false;
+    }
+  }
+  if (argc < 5 || !validOptions) {
     std::cout
-        << "Expected usage: static_eraser <path> <commit_hash> <initial_commit> <simplified_output>"
-        << std::endl;
+        << "Expected usage: static_eraser <path> <commit_hash> <initial_commit> <simplified_output> [--metrics-json=FILE] [--metrics-prom=FILE] [--trace=FILE] [--roots=F,G,...] [--sql-profile[=N]] [--sql-profile-csv=FILE] [--stream-races=FILE] [--priority] [--budget-iterations=N] [--budget-ms=N] [--budget-state=N] [--resume] [--checkpoint-ms=N] [--summary-cache=DIR] [--gc-size-mb=N] [--gc-free-percent=P] [--baseline=NAME]"
+        << std::endl
+        << "       static_eraser --gc [--baseline=NAME]" << std::endl
+        << "       static_eraser --export-snapshot <file> [--baseline=NAME]"
+        << std::endl
+        << "       static_eraser --import-snapshot <file_or_dir> [<path>] "
+           "[--baseline=NAME]"
+        << std::endl
+        << "       static_eraser --baselines" << std::endl;
     return 0;
   }
+  if (!baselineName.empty() && !BaselineStore::isValidName(baselineName)) {
+    std::cerr << "Invalid baseline name " << baselineName
+              << ", names cannot be empty or contain / or .." << std::endl;
+    return 1;
+  }
   std::string repoPath = argv[1];
   std::string currHash = argv[2];
 
-  bool initialCommit = (std::string(argv[3]) == "y" || std::string(argv[3]) == "Y") ||
-                       !fileExists(Database::dbName);
+  if (!baselineName.empty()) {
+    // baselines are matched to ancestors by full hash, so names such as HEAD
+    // are resolved first
+    std::vector<std::string> ancestors =
+        DiffAnalysis(nullptr).getAncestors(repoPath, currHash);
+    if (!ancestors.empty()) {
+      currHash = ancestors[0];
+    }
+    BaselineStore baselines;
+    dbPath = baselines.getPath(baselineName);
+    if (!baselines.exists(baselineName)) {
+      std::string parent = baselines.findParent(ancestors);
+      if (parent != "" && baselines.fork(parent, baselineName)) {
+        std::cout << "Forked baseline " << baselineName << " from " << parent
+                  << std::endl;
+      }
+    }
+  }
+
+  bool resuming = false;
+  // the previous hash is only set once a run finishes
+  bool analysed = false;
+  if (fileExists(dbPath)) {
+    Database existingDb(false, dbPath);
+    EraserSettings existingSettings(&existingDb);
+    if (existingSettings.hasCurrentAnalysisVersion()) {
+      resuming = resume && Checkpoints(&existingDb).hasUnfinishedRun();
+      analysed = existingSettings.getPrevHash() != "";
+    } else {
+      std::cout << dbPath << " was written with analysis version "
+                << existingSettings.getAnalysisVersion() << ", expected "
+                << analysisVersion << ", starting an initial run"
+                << std::endl;
+    }
+  }
+  if (resume && !resuming) {
+    std::cout << "No interrupted run to resume, starting a new one"
+              << std::endl;
+  }
+
+  bool initialCommit =
+      !resuming &&
+      ((std::string(argv[3]) == "y" || std::string(argv[3]) == "Y") ||
+       !analysed);
 
   saveTimes = (std::string(argv[4]) == "y" || std::string(argv[4]) == "Y");
 
@@ -67,20 +312,50 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (!tracePath.empty()) {
+    Tracer::instance().start(tracePath);
+  }
+
   auto startTime = std::chrono::high_resolution_clock::now();
   auto currTime = startTime;
 
-  Database db(initialCommit);
-  FunctionEraserSets functionEraserSets(&db);
-  CallGraph callGraph(&db);
-  FileIncludes fileIncludes(&db);
+  Database db(initialCommit, dbPath);
+  if (sqlProfileTop > 0 || !sqlProfileCsvPath.empty()) {
+    db.enableProfiling();
+  }
+  AnalysisPipeline pipeline(&db);
+  if (!initialCommit && !resuming &&
+      pipeline.getCheckpoints()->hasUnfinishedRun()) {
+    std::cerr << "The previous run was interrupted, pass --resume to continue "
+                 "it or start again from an initial commit"
+              << std::endl;
+    return 1;
+  }
+  pipeline.setRoots(roots);
+  pipeline.setPriorityOrdering(priorityOrdering);
+  pipeline.setFunctionBudget(functionBudget);
+  if (!summaryCachePath.empty()) {
+    pipeline.setSummaryCache(summaryCachePath);
+  }
+  pipeline.setCheckpointInterval(checkpointMs);
+  std::ofstream raceStream;
+  if (!streamRacesPath.empty()) {
+    raceStream.open(streamRacesPath);
+    if (!raceStream.is_open()) {
+      std::cerr << "Failed to open " << streamRacesPath << " for writing."
+                << std::endl;
+      return 1;
+    }
+    pipeline.setRaceStream(&raceStream);
+  }
   EraserSettings eraserSettings(&db);
-  DiffAnalysis diffAnalysis(&fileIncludes);
-  Parser parser(&callGraph, &fileIncludes);
+  DiffAnalysis diffAnalysis(pipeline.getFileIncludes());
 
-  std::string prevHash = eraserSettings.getAndUpdatePrevHash(currHash);
+  std::string prevHash = eraserSettings.getPrevHash();
   std::set<std::string> changedFiles;
-  if (initialCommit) {
+  if (resuming) {
+    // the files of the interrupted run are in its checkpoint
+  } else if (initialCommit) {
     changedFiles = diffAnalysis.getAllFiles(repoPath);
   } else {
     changedFiles = diffAnalysis.getChangedFiles(repoPath, prevHash, currHash);
@@ -203,53 +478,73 @@ int main(int argc, char *argv[]) {
     */
 
   // changedFiles = {"test_files/Splash-4/altered/cholesky/amal.c"};
-  debugCout << "Parsing changed files:" << std::endl;
-  for (const auto &file : changedFiles) {
-    debugCout << file << std::endl;
-    callGraph.markNodesAsStale(file);
-    parser.parseFile(file.c_str(), true);
+  if (resuming) {
+    pipeline.resumeRun();
+  } else {
+    pipeline.parseChangedFiles(changedFiles);
   }
-  debugCout << std::endl;
-
-  std::vector<std::string> functions = parser.getFunctions();
 
   GraphVisualizer visualizer;
   // visualizer.visualizeGraph(funcCfgs["ConsiderMerge"]);
 
   logTimeSinceLast("Parsing time: ", currTime);
 
-  DeltaLockset deltaLockset(&callGraph, &parser, &functionEraserSets);
-  deltaLockset.updateLocksets(functions);
-
+  pipeline.updateDeltaLocksets();
   logTimeSinceLast("Phase 1 time: ", currTime);
 
-  FunctionVariableLocksets functionVariableLocksets(&db);
-
-  FunctionCumulativeLocksets functionCumulativeLocksets(
-      &db, &functionVariableLocksets);
-
-  VariableLocksets variableLocksets(&callGraph, &parser,
-                                    &functionVariableLocksets);
-
-  CumulativeLocksets cumulativeLocksets(&callGraph,
-                                        &functionCumulativeLocksets);
-
-  variableLocksets.updateLocksets();
+  pipeline.updateVariableLocksets();
   logTimeSinceLast("Phase 2 time: ", currTime);
-  cumulativeLocksets.updateLocksets();
+  pipeline.updateCumulativeLocksets();
   logTimeSinceLast("Phase 3 time: ", currTime);
+  // a resumed run may have deferred functions left without --priority
+  pipeline.updateDeferredDeltaLocksets();
+  if (priorityOrdering) {
+    logTimeSinceLast("Deferred phase 1 time: ", currTime);
+  }
 
-  functionEraserSets.markFunctionEraserSetsAsOld();
-  functionVariableLocksets.markFunctionVariableLocksetsAsOld();
-  callGraph.deleteStaleNodes();
+  db.beginTransaction("mark results as old");
+  eraserSettings.setPrevHash(currHash);
+  pipeline.markResultsAsOld();
+  db.commitTransaction();
 
-  std::set<std::string> dataRaces =
-      functionCumulativeLocksets.detectDataRaces();
+  std::map<std::string, std::set<std::string>> rootDataRaces =
+      pipeline.detectDataRacesPerRoot();
+  std::set<std::string> dataRaces;
+  for (const auto &pair : rootDataRaces) {
+    dataRaces += pair.second;
+  }
+
+  std::set<std::string> widenedFunctions = pipeline.getWidenedFunctions();
+  if (!widenedFunctions.empty()) {
+    std::cout << "Functions widened after exceeding their budget:"
+              << std::endl;
+    for (const std::string &funcName : widenedFunctions) {
+      std::cout << funcName << std::endl;
+    }
+  }
 
   std::cout << "Variables with data races:" << std::endl;
   for (const std::string &dataRace : dataRaces) {
     std::cout << dataRace << std::endl;
   }
+  if (rootDataRaces.size() > 1) {
+    for (const auto &pair : rootDataRaces) {
+      std::cout << "Variables with data races from " << pair.first << ":"
+                << std::endl;
+      for (const std::string &dataRace : pair.second) {
+        std::cout << dataRace << std::endl;
+      }
+    }
+  }
+
+  DatabaseMaintenance maintenance(&db);
+  if ((gcSizeMb > 0 && maintenance.getSizeBytes() >= gcSizeMb * 1024 * 1024) ||
+      (gcFreePercent > 0 &&
+       maintenance.getFreeFraction() * 100 >= gcFreePercent)) {
+    maintenance.collectGarbage();
+    maintenance.printReport(std::cout);
+    logTimeSinceLast("Garbage collection time: ", currTime);
+  }
 
   auto endTime = std::chrono::high_resolution_clock::now();
   auto duration =
@@ -261,24 +556,45 @@ int main(int argc, char *argv[]) {
   }
   std::cout << "Total time taken: " << duration << "ms" << std::endl;
 
-  std::ifstream statFile("/proc/self/stat");
-  std::string statLine;
-  std::getline(statFile, statLine);
-  std::istringstream iss(statLine);
-  std::string entry;
-  long long memUsage;
-  for (int i = 1; i <= 24; i++) {
-    std::getline(iss, entry, ' ');
-    if (i == 24) {
-      memUsage = stoi(entry);
-    }
-  }
+  // ru_maxrss is the peak resident set size in kilobytes on Linux
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  long long memUsage = usage.ru_maxrss;
   if (saveTimes) {
-    outFile << (int)(4096 * memUsage / 1e3);
+    outFile << memUsage;
   }
-  std::cout << "Memory usage: " << (int)(4096 * memUsage / 1e3) << " KB"
-            << std::endl;
+  std::cout << "Peak memory usage: " << memUsage << " KB" << std::endl;
   std::cout << std::endl;
+
+  Metrics::instance().setGauge("races_detected", dataRaces.size());
+  Metrics::instance().setGauge("functions_widened", widenedFunctions.size());
+  Metrics::instance().setGauge("total_ms", duration);
+  Metrics::instance().updateProcessGauges();
+  if (!metricsJsonPath.empty()) {
+    std::ofstream metricsFile(metricsJsonPath);
+    if (!metricsFile.is_open()) {
+      std::cerr << "Failed to open " << metricsJsonPath << " for writing."
+                << std::endl;
+    }
+    Metrics::instance().writeJson(metricsFile);
+  }
+  if (!metricsPromPath.empty()) {
+    std::ofstream metricsFile(metricsPromPath);
+    if (!metricsFile.is_open()) {
+      std::cerr << "Failed to open " << metricsPromPath << " for writing."
+                << std::endl;
+    }
+    Metrics::instance().writePrometheus(metricsFile);
+  }
+  if (!tracePath.empty()) {
+    Tracer::instance().finish();
+  }
+  if (sqlProfileTop > 0) {
+    db.getProfiler()->printReport(std::cout, sqlProfileTop);
+  }
+  if (!sqlProfileCsvPath.empty()) {
+    db.getProfiler()->writeCsv(sqlProfileCsvPath);
+  }
   if (outFile.is_open()) {
     outFile.close();
   }
@@ -0,0 +1,153 @@
+#include "metrics.h"
+#include <cmath>
+#include <sys/resource.h>
+
+// 1, 2, 5, 10, 20, 50... up to 5e6, anything larger only counts towards +Inf
+static std::vector<double> defaultBounds() {
+  std::vector<double> bounds;
+  for (double scale = 1; scale <= 1e6; scale *= 10) {
+    bounds.push_back(scale);
+    bounds.push_back(2 * scale);
+    bounds.push_back(5 * scale);
+  }
+  return bounds;
+}
+
+static std::string formatNumber(double value) {
+  if (!std::isfinite(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.15g", value);
+  return buffer;
+}
+
+Metrics &Metrics::instance() {
+  static Metrics metrics;
+  return metrics;
+}
+
+MetricCounter &Metrics::counter(const std::string &name) {
+  return counters[name];
+}
+
+MetricHistogram &Metrics::histogram(const std::string &name) {
+  auto it = histograms.find(name);
+  if (it == histograms.end()) {
+    MetricHistogram histogram;
+    histogram.bounds = defaultBounds();
+    histogram.buckets = std::vector<long long>(histogram.bounds.size(), 0);
+    it = histograms.insert({name, histogram}).first;
+  }
+  return it->second;
+}
+
+void Metrics::observe(MetricHistogram &histogram, double value) {
+  histogram.count++;
+  histogram.sum += value;
+  for (size_t i = 0; i < histogram.bounds.size(); i++) {
+    if (value <= histogram.bounds[i]) {
+      histogram.buckets[i]++;
+      return;
+    }
+  }
+}
+
+void Metrics::setGauge(const std::string &name, double value) {
+  gauges[name] = value;
+}
+
+void Metrics::updateProcessGauges() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    // ru_maxrss is in kilobytes on Linux
+    setGauge("peak_rss_bytes", usage.ru_maxrss * 1024.0);
+  }
+}
+
+// call sites keep references into the maps, so entries are zeroed rather
+// than erased
+void Metrics::reset() {
+  for (auto &pair : counters) {
+    pair.second.value = 0;
+  }
+  for (auto &pair : histograms) {
+    MetricHistogram &histogram = pair.second;
+    histogram.buckets.assign(histogram.bounds.size(), 0);
+    histogram.count = 0;
+    histogram.sum = 0;
+  }
+  gauges.clear();
+}
+
+void Metrics::writeJson(std::ostream &stream) {
+  stream << "{\n  \"counters\": {";
+  std::string separator = "\n";
+  for (auto &pair : counters) {
+    stream << separator << "    \"" << pair.first
+           << "\": " << pair.second.value.load();
+    separator = ",\n";
+  }
+  stream << "\n  },\n  \"histograms\": {";
+  separator = "\n";
+  for (auto &pair : histograms) {
+    MetricHistogram &histogram = pair.second;
+    stream << separator << "    \"" << pair.first << "\": {\"count\": "
+           << histogram.count << ", \"sum\": " << formatNumber(histogram.sum)
+           << ", \"buckets\": [";
+    long long cumulative = 0;
+    for (size_t i = 0; i < histogram.bounds.size(); i++) {
+      cumulative += histogram.buckets[i];
+      stream << (i == 0 ? "" : ", ") << "{\"le\": "
+             << formatNumber(histogram.bounds[i])
+             << ", \"count\": " << cumulative << "}";
+    }
+    stream << "]}";
+    separator = ",\n";
+  }
+  stream << "\n  },\n  \"gauges\": {";
+  separator = "\n";
+  for (auto &pair : gauges) {
+    stream << separator << "    \"" << pair.first
+           << "\": " << formatNumber(pair.second);
+    separator = ",\n";
+  }
+  stream << "\n  }\n}\n";
+}
+
+void Metrics::writePrometheus(std::ostream &stream) {
+  for (auto &pair : counters) {
+    std::string name = "eraser_" + pair.first + "_total";
+    stream << "# TYPE " << name << " counter\n"
+           << name << " " << pair.second.value.load() << "\n";
+  }
+  for (auto &pair : histograms) {
+    MetricHistogram &histogram = pair.second;
+    std::string name = "eraser_" + pair.first;
+    stream << "# TYPE " << name << " histogram\n";
+    long long cumulative = 0;
+    for (size_t i = 0; i < histogram.bounds.size(); i++) {
+      cumulative += histogram.buckets[i];
+      stream << name << "_bucket{le=\"" << formatNumber(histogram.bounds[i])
+             << "\"} " << cumulative << "\n";
+    }
+    stream << name << "_bucket{le=\"+Inf\"} " << histogram.count << "\n"
+           << name << "_sum " << formatNumber(histogram.sum) << "\n"
+           << name << "_count " << histogram.count << "\n";
+  }
+  for (auto &pair : gauges) {
+    std::string name = "eraser_" + pair.first;
+    stream << "# TYPE " << name << " gauge\n"
+           << name << " " << formatNumber(pair.second) << "\n";
+  }
+}
+
+MetricTimer::MetricTimer(MetricHistogram &histogram)
+    : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+MetricTimer::~MetricTimer() {
+  Metrics::instance().observe(
+      histogram, std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - start)
+                     .count());
+}
@@ -1,7 +1,12 @@
 #include "parser.h"
+#include "fnv_hash.h"
+#include "metrics.h"
+#include "trace.h"
 
 static std::unordered_map<std::string, bool> funcMap = {};
 static std::vector<std::string> functions = {};
+// functions built since the run started
+static std::set<std::string> runFunctions = {};
 static std::set<std::string> functionDeclarations = {};
 static std::vector<std::unordered_map<std::string, VariableInfo>> scopeStack =
     {};
@@ -15,16 +20,35 @@ static ConstructionEnvironment *environment;
 static CallGraph *callGraph;
 static bool updateCallGraph;
 static bool eraserIgnoreOn = false;
+// shared by every function with a CFG_TRIVIAL CFG
+static StartNode *trivialCfg = nullptr;
+// variable and parameter declarations of the current translation unit
+static std::unordered_map<CXCursor, VariableInfo, CursorHash, CursorEqual>
+    declarations;
+// headers fully visited this run
+static std::unordered_map<std::string, SeenFile> seenFiles;
+static CXTranslationUnit currUnit;
+// header -> whether its declarations are only registered in this translation
+// unit, and its content hash
+static std::unordered_map<std::string, std::pair<bool, uint64_t>>
+    headerDecisions;
 
 std::unordered_map<std::string, StartNode *> funcCfgs;
 
 Parser::Parser(CallGraph *callGraphPtr, FileIncludes *fileIncludesPtr) {
   funcCfgs = {};
+  functions = {};
+  seenFiles = {};
   callGraph = callGraphPtr;
   fileIncludes = fileIncludesPtr;
   environment = new ConstructionEnvironment();
+  trivialCfg = environment->startNewTree("");
+  trivialCfg->kind = CFG_TRIVIAL;
+  environment->onAdd(new ReturnNode());
 }
 
+void deallocateCFG(StartNode *node);
+
 std::string getCursorFilename(CXCursor cursor) {
   CXSourceLocation location = clang_getCursorLocation(cursor);
 
@@ -92,6 +116,18 @@ VariableInfo findVariableInfo(std::string varName) {
   return variableInfo;
 }
 
+// Resolves a reference through the declaration it refers to. Anything that is
+// not a variable declared in this translation unit, e.g. an enum constant,
+// falls back to looking the name up in the scope stack.
+VariableInfo resolveVariable(CXCursor cursor, const std::string &varName) {
+  auto it = declarations.find(clang_getCursorReferenced(cursor));
+  if (it != declarations.end()) {
+    return it->second;
+  }
+  metricCount("references_resolved_by_name", 1);
+  return findVariableInfo(varName);
+}
+
 bool isSharedVar(struct VariableInfo variableInfo) {
   return !variableInfo.isAtomic &&
          (variableInfo.isStatic || variableInfo.scopeDepth == 0);
@@ -131,15 +167,17 @@ CXCursor getFirstChild(CXCursor cursor) {
   return firstChild;
 }
 
-std::string getNthArg(CXCursor cursor, int targetArg, bool isPtr = false) {
+std::string getNthArg(CXCursor cursor, int targetArg, bool isPtr = false,
+                      CXCursor *argRef = nullptr) {
   struct ArgClientData {
     int targetArg;
     bool isPtr;
     int argNum;
-    CXCursor *argCursor;
+    CXCursor argCursor;
   };
 
-  struct ArgClientData clientData = {targetArg, isPtr, 0, NULL};
+  struct ArgClientData clientData = {targetArg, isPtr, 0,
+                                     clang_getNullCursor()};
 
   clang_visitChildren(
       cursor,
@@ -148,7 +186,7 @@ std::string getNthArg(CXCursor cursor, int targetArg, bool isPtr = false) {
             reinterpret_cast<struct ArgClientData *>(clientData);
 
         if (argClientData->argNum == argClientData->targetArg) {
-          argClientData->argCursor = &c;
+          argClientData->argCursor = c;
           if (argClientData->isPtr &&
               clang_getCursorKind(c) == CXCursor_UnaryOperator) {
             argClientData->isPtr = false;
@@ -164,12 +202,15 @@ std::string getNthArg(CXCursor cursor, int targetArg, bool isPtr = false) {
       &clientData);
 
   if (clientData.argNum >= targetArg && !clientData.isPtr) {
-    CXCursor argCursor = *clientData.argCursor;
+    CXCursor argCursor = clientData.argCursor;
 
     while (clang_getCursorKind(argCursor) == CXCursor_ParenExpr || clang_getCursorKind(argCursor) == CXCursor_UnexposedExpr) {
       argCursor = getFirstChild(argCursor);
     }
     if (clang_getCursorKind(argCursor) == CXCursor_DeclRefExpr) {
+      if (argRef != nullptr) {
+        *argRef = argCursor;
+      }
       CXString argSpelling = clang_getCursorSpelling(argCursor);
       std::string result = clang_getCString(argSpelling);
       clang_disposeString(argSpelling);
@@ -196,8 +237,9 @@ void handleFunctionCall(CXCursor cursor, std::vector<GraphNode *> *nodesToAdd) {
     environment->onAdd(new EraserIgnoreOffNode());
   } else if (funcName == "pthread_mutex_lock" ||
     funcName == "pthread_mutex_unlock") {
-    std::string spelling = getNthArg(cursor, 1, true);
-    VariableInfo variableInfo = findVariableInfo(spelling);
+    CXCursor argRef = clang_getNullCursor();
+    std::string spelling = getNthArg(cursor, 1, true, &argRef);
+    VariableInfo variableInfo = resolveVariable(argRef, spelling);
     if (isSharedVar(variableInfo)) {
       std::string varName = getVariableName(spelling, cursor, variableInfo);
       if (funcName == "pthread_mutex_lock") {
@@ -207,8 +249,9 @@ void handleFunctionCall(CXCursor cursor, std::vector<GraphNode *> *nodesToAdd) {
       }
     }
   } else if (funcName == "pthread_join") {
-    std::string spelling = getNthArg(cursor, 1);
-    VariableInfo variableInfo = findVariableInfo(spelling);
+    CXCursor argRef = clang_getNullCursor();
+    std::string spelling = getNthArg(cursor, 1, false, &argRef);
+    VariableInfo variableInfo = resolveVariable(argRef, spelling);
     std::string varName = getVariableName(spelling, cursor, variableInfo);
     bool global = isSharedVar(variableInfo);
     if (varName != "") {
@@ -218,8 +261,9 @@ void handleFunctionCall(CXCursor cursor, std::vector<GraphNode *> *nodesToAdd) {
     if (funcName == "pthread_create") {
       std::string called = getNthArg(cursor, 3);
       if (called != "") {
-        std::string spelling = getNthArg(cursor, 1, true);
-        VariableInfo variableInfo = findVariableInfo(spelling);
+        CXCursor argRef = clang_getNullCursor();
+        std::string spelling = getNthArg(cursor, 1, true, &argRef);
+        VariableInfo variableInfo = resolveVariable(argRef, spelling);
         std::string varName = getVariableName(spelling, cursor, variableInfo);
         std::string funcName = getFuncName(cursor, called);
         bool global = isSharedVar(variableInfo);
@@ -271,9 +315,10 @@ void classifyVariable(CXCursor cursor, LhsType lhsType,
     variableInfo.scopeDepth = scopeDepth;
     variableInfo.scopeNum = scopeNums[scopeDepth];
     scopeStack[scopeDepth].insert({varName, variableInfo});
+    declarations.insert({cursor, variableInfo});
     return;
   } else {
-    variableInfo = findVariableInfo(varName);
+    variableInfo = resolveVariable(cursor, varName);
   }
   if (variableInfo.isAtomic ||
       (!variableInfo.isStatic && variableInfo.scopeDepth > 0)) {
@@ -343,13 +388,143 @@ BranchType getBranchType(CXCursor cursor, CXCursor parent,
 void onNewScope() {
   scopeDepth += 1;
   scopeStack.push_back(std::unordered_map<std::string, VariableInfo>());
-  if (scopeDepth >= scopeNums.size()) {
+  if ((size_t)scopeDepth >= scopeNums.size()) {
     scopeNums.push_back(0);
   } else {
     scopeNums[scopeDepth] += 1;
   }
 }
 
+void registerFunction(CXCursor cursor) {
+  inFunc = 1;
+  funcName = clang_getCString(clang_getCursorSpelling(cursor));
+  bool isStatic = clang_Cursor_getStorageClass(cursor) == CX_SC_Static;
+  funcMap.insert({funcName, isStatic});
+  if (isStatic) {
+    std::string fileName = getCursorFilename(cursor);
+    funcName = fileName + " " + funcName;
+  }
+  functionDeclarations.insert(funcName);
+}
+
+// Visitor for declarations that are not analysed. Only keeps the symbol
+// tables and scope numbering in step, as the names of static and thread
+// variables declared later depend on them.
+CXChildVisitResult registerVisitor(CXCursor cursor, CXCursor, CXClientData) {
+  CXCursorKind cursorKind = clang_getCursorKind(cursor);
+  if (cursorKind == CXCursor_FunctionDecl) {
+    ignoreNextCompound = true;
+    onNewScope();
+    registerFunction(cursor);
+  } else if (cursorKind == CXCursor_CompoundStmt) {
+    if (ignoreNextCompound) {
+      ignoreNextCompound = false;
+    } else {
+      onNewScope();
+    }
+  } else if (cursorKind == CXCursor_VarDecl && scopeDepth == 0) {
+    classifyVariable(cursor, LHS_NONE, nullptr);
+  }
+
+  clang_visitChildren(cursor, registerVisitor, nullptr);
+
+  if (cursorKind == CXCursor_CompoundStmt) {
+    scopeStack.pop_back();
+    scopeDepth -= 1;
+  } else if (cursorKind == CXCursor_FunctionDecl) {
+    if (ignoreNextCompound) {
+      scopeStack.pop_back();
+      scopeDepth -= 1;
+    }
+    ignoreNextCompound = false;
+    inFunc = 0;
+  }
+  return CXChildVisit_Continue;
+}
+
+// Declarations from system headers, and from headers already visited this run
+// with the same contents, are only registered. A header first visited without
+// updating the call graph is visited again when the call graph is updated.
+bool shouldOnlyRegister(CXCursor cursor) {
+  CXSourceLocation location = clang_getCursorLocation(cursor);
+  if (clang_Location_isInSystemHeader(location)) {
+    metricCount("system_header_decls_skipped", 1);
+    return true;
+  }
+  if (clang_Location_isFromMainFile(location)) {
+    return false;
+  }
+
+  CXFile file;
+  unsigned line, column, offset;
+  clang_getFileLocation(location, &file, &line, &column, &offset);
+  if (file == nullptr) {
+    return false;
+  }
+  CXString fileNameObj = clang_getFileName(file);
+  std::string fileName = clang_getCString(fileNameObj);
+  clang_disposeString(fileNameObj);
+
+  auto it = headerDecisions.find(fileName);
+  if (it == headerDecisions.end()) {
+    size_t size = 0;
+    const char *contents = clang_getFileContents(currUnit, file, &size);
+    uint64_t contentHash = fnvHash(contents, contents == nullptr ? 0 : size);
+    auto seen = seenFiles.find(fileName);
+    bool registerOnly = seen != seenFiles.end() &&
+                        seen->second.contentHash == contentHash &&
+                        (seen->second.updatedCallGraph || !updateCallGraph);
+    it = headerDecisions.insert({fileName, {registerOnly, contentHash}}).first;
+  }
+  if (it->second.first) {
+    metricCount("seen_header_decls_skipped", 1);
+  }
+  return it->second.first;
+}
+
+// Phase 1 sets these flags as it goes through a CFG, they are set here too so
+// that CFGs parsed after phase 1, e.g. by a resumed run, have them as well. A
+// node is ignored when every path to it passes an EraserIgnoreOn that no
+// EraserIgnoreOff follows.
+static void setEraserIgnoreFlags(StartNode *startNode) {
+  std::unordered_map<GraphNode *, bool> ignored = {{startNode, false}};
+  std::vector<GraphNode *> worklist = {startNode};
+  while (!worklist.empty()) {
+    GraphNode *node = worklist.back();
+    worklist.pop_back();
+    for (GraphNode *nextNode : node->getNextNodes()) {
+      bool nextIgnored = ignored[node];
+      if (dynamic_cast<EraserIgnoreOnNode *>(nextNode)) {
+        nextIgnored = true;
+      } else if (dynamic_cast<EraserIgnoreOffNode *>(nextNode)) {
+        nextIgnored = false;
+      }
+      auto it = ignored.find(nextNode);
+      if (it == ignored.end()) {
+        ignored.insert({nextNode, nextIgnored});
+        worklist.push_back(nextNode);
+      } else if (it->second && !nextIgnored) {
+        it->second = false;
+        worklist.push_back(nextNode);
+      }
+    }
+  }
+  for (const auto &pair : ignored) {
+    pair.first->eraserIgnoreOn = pair.second;
+  }
+}
+
+CXChildVisitResult visitor(CXCursor cursor, CXCursor parent,
+                           CXClientData clientData);
+
+CXChildVisitResult topLevelVisitor(CXCursor cursor, CXCursor parent,
+                                   CXClientData clientData) {
+  if (shouldOnlyRegister(cursor)) {
+    return registerVisitor(cursor, parent, nullptr);
+  }
+  return visitor(cursor, parent, clientData);
+}
+
 CXChildVisitResult visitor(CXCursor cursor, CXCursor parent,
                            CXClientData clientData) {
   CXCursorKind cursorKind = clang_getCursorKind(cursor);
@@ -357,15 +532,7 @@ CXChildVisitResult visitor(CXCursor cursor, CXCursor parent,
   if (cursorKind == CXCursor_FunctionDecl) {
     ignoreNextCompound = true;
     onNewScope();
-    inFunc = 1;
-    funcName = clang_getCString(clang_getCursorSpelling(cursor));
-    bool isStatic = clang_Cursor_getStorageClass(cursor) == CX_SC_Static;
-    funcMap.insert({funcName, isStatic});
-    if (isStatic) {
-      std::string fileName = getCursorFilename(cursor);
-      funcName = fileName + " " + funcName;
-    }
-    functionDeclarations.insert(funcName);
+    registerFunction(cursor);
   } else if (cursorKind == CXCursor_CompoundStmt) {
     if (ignoreNextCompound) {
       startNode = environment->startNewTree(funcName);
@@ -470,8 +637,32 @@ CXChildVisitResult visitor(CXCursor cursor, CXCursor parent,
     inFunc = 0;
     if (startNode != nullptr) {
       environment->onAdd(new ReturnNode());
+      environment->sliceCfg();
+      CfgKind kind = environment->getCfgKind();
+      if (kind == CFG_TRIVIAL) {
+        deallocateCFG(startNode);
+        startNode = trivialCfg;
+        metricCount("trivial_functions", 1);
+      } else {
+        startNode->kind = kind;
+        setEraserIgnoreFlags(startNode);
+        if (kind == CFG_ACYCLIC) {
+          metricCount("acyclic_functions", 1);
+        }
+      }
       functions.push_back(funcName);
-      funcCfgs.insert({funcName, startNode});
+      // CFGs built by earlier runs are kept, and replaced when their
+      // function is built again
+      auto it = funcCfgs.find(funcName);
+      if (it == funcCfgs.end()) {
+        funcCfgs.insert({funcName, startNode});
+      } else if (runFunctions.find(funcName) == runFunctions.end()) {
+        if (it->second != trivialCfg) {
+          deallocateCFG(it->second);
+        }
+        it->second = startNode;
+      }
+      runFunctions.insert(funcName);
       startNode = nullptr;
     }
   }
@@ -481,7 +672,15 @@ CXChildVisitResult visitor(CXCursor cursor, CXCursor parent,
   return CXChildVisit_Continue;
 }
 
+void Parser::startRun() {
+  functions = {};
+  runFunctions = {};
+}
+
 void Parser::parseFile(const char *fileName, bool fileChanged) {
+  metricTimer("parse_file_ms");
+  TraceSpan span("parse", fileName);
+  metricCount("files_parsed", 1);
   funcMap = {};
   functionDeclarations = {};
   scopeStack.clear();
@@ -495,9 +694,20 @@ void Parser::parseFile(const char *fileName, bool fileChanged) {
 
   scopeStack.push_back(std::unordered_map<std::string, VariableInfo>());
 
+  std::vector<CXUnsavedFile> unsaved;
+  for (const auto &pair : unsavedFiles) {
+    unsaved.push_back(
+        {pair.first.c_str(), pair.second.c_str(), pair.second.size()});
+  }
+
   CXIndex index = clang_createIndex(0, 0);
-  CXTranslationUnit unit = clang_parseTranslationUnit(
-      index, fileName, nullptr, 0, nullptr, 0, CXTranslationUnit_None);
+  CXTranslationUnit unit;
+  {
+    metricTimer("libclang_parse_ms");
+    unit = clang_parseTranslationUnit(index, fileName, nullptr, 0,
+                                      unsaved.data(), unsaved.size(),
+                                      CXTranslationUnit_None);
+  }
 
   if (unit == nullptr) {
     std::cerr << "Unable to parse translation unit. Quitting." << std::endl;
@@ -508,7 +718,19 @@ void Parser::parseFile(const char *fileName, bool fileChanged) {
 
   VisitorData initialData = {0, {}, LHS_NONE};
 
-  clang_visitChildren(cursor, visitor, &initialData);
+  currUnit = unit;
+  declarations = {};
+  headerDecisions = {};
+  clang_visitChildren(cursor, topLevelVisitor, &initialData);
+  for (const auto &pair : headerDecisions) {
+    if (!pair.second.first) {
+      SeenFile &seen = seenFiles[pair.first];
+      seen.updatedCallGraph =
+          (seen.contentHash == pair.second.second && seen.updatedCallGraph) ||
+          updateCallGraph;
+      seen.contentHash = pair.second.second;
+    }
+  }
 
   if (fileChanged) {
     this->fileNameString = fileName;
@@ -536,16 +758,27 @@ void Parser::parseFile(const char *fileName, bool fileChanged) {
 
 std::vector<std::string> Parser::getFunctions() { return functions; }
 
+void Parser::setUnsavedFile(const std::string &fileName,
+                            const std::string &contents) {
+  unsavedFiles[fileName] = contents;
+}
+
+void Parser::removeUnsavedFile(const std::string &fileName) {
+  unsavedFiles.erase(fileName);
+}
+
+bool Parser::hasUnsavedFile(const std::string &fileName) {
+  return unsavedFiles.find(fileName) != unsavedFiles.end();
+}
+
 void deallocateCFG(StartNode *node) {
   std::set<GraphNode *> nodes = {node};
   std::vector<GraphNode *> stack = {node};
   while (stack.size() > 0) {
     GraphNode *currNode = stack.back();
     stack.pop_back();
-    std::vector<GraphNode *> nextNodes = currNode->getNextNodes();
-    for (int i = 0; i < nextNodes.size(); i++) {
-      GraphNode *nextNode = nextNodes[i];
-      if (nodes.find(nextNode) != nodes.end()) {
+    for (GraphNode *nextNode : currNode->getNextNodes()) {
+      if (nodes.find(nextNode) == nodes.end()) {
         nodes.insert(nextNode);
         stack.push_back(nextNode);
       }
@@ -559,6 +792,9 @@ void deallocateCFG(StartNode *node) {
 Parser::~Parser() {
   delete environment;
   for (auto it = funcCfgs.begin(); it != funcCfgs.end(); ++it) {
-    deallocateCFG(it->second);
+    if (it->second != trivialCfg) {
+      deallocateCFG(it->second);
+    }
   }
+  deallocateCFG(trivialCfg);
 }
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "race_reporter.h"
+#include "metrics.h"
+#include "set_operations.h"
+#include "trace.h"
+
+RaceReporter::RaceReporter(
+    std::ostream *stream, CallGraph *callGraph,
+    FunctionCumulativeLocksets *functionCumulativeLocksets,
+    LocksetTable *locksetTable)
+    : stream(stream), callGraph(callGraph),
+      functionCumulativeLocksets(functionCumulativeLocksets),
+      locksetTable(locksetTable),
+      startTime(std::chrono::steady_clock::now()) {}
+
+void RaceReporter::startPhase(const std::set<std::string> &roots,
+                              const std::vector<std::string> &ordering) {
+  std::set<std::string> visited(ordering.begin(), ordering.end());
+  pendingRoots = roots;
+  reachable = {};
+  sharedModified = {};
+  staleRoots = {};
+  for (const std::string &root : roots) {
+    std::set<std::string> functions =
+        callGraph->getCurrentReachableFunctions({root});
+    if (functions.find(root) == functions.end()) {
+      staleRoots.insert(root);
+    }
+    if (visited.find(root) == visited.end()) {
+      // phase 3 leaves the root's lockset as it is
+      finishRoot(root);
+      continue;
+    }
+    reachable[root] = functions;
+    sharedModified[root] =
+        functionCumulativeLocksets->getSharedModifiedVariables(root);
+  }
+}
+
+void RaceReporter::functionFinished(const std::string &funcName,
+                                    const FunctionCumulativeData *data) {
+  if (data != nullptr) {
+    for (const auto &pair : reachable) {
+      const std::string &root = pair.first;
+      auto test = data->locksets.find(root);
+      if (pair.second.find(funcName) == pair.second.end() ||
+          test == data->locksets.end()) {
+        continue;
+      }
+      const std::set<std::string> &variables = sharedModified[root];
+      for (const auto &variable : test->second) {
+        if (variables.find(variable.first) != variables.end() &&
+            locksetTable->get(variable.second).empty()) {
+          report(root, variable.first, funcName);
+        }
+      }
+    }
+  }
+  if (pendingRoots.find(funcName) != pendingRoots.end()) {
+    finishRoot(funcName);
+  }
+}
+
+void RaceReporter::finishPhase() {
+  std::set<std::string> roots = pendingRoots;
+  for (const std::string &root : roots) {
+    finishRoot(root);
+  }
+  *stream << "{\"event\": \"done\", \"races\": " << variablesReported.size()
+          << ", \"elapsed_ms\": " << elapsedMs() << "}" << std::endl;
+}
+
+int RaceReporter::getRacesReported() { return variablesReported.size(); }
+
+void RaceReporter::finishRoot(const std::string &root) {
+  std::set<std::string> races = {};
+  if (staleRoots.find(root) == staleRoots.end()) {
+    races = functionCumulativeLocksets->detectDataRaces(root);
+  }
+  for (const std::string &varName : races) {
+    report(root, varName, root);
+  }
+  for (const std::string &varName : reported[root] - races) {
+    retract(root, varName);
+  }
+  pendingRoots.erase(root);
+  reachable.erase(root);
+  sharedModified.erase(root);
+}
+
+void RaceReporter::report(const std::string &root, const std::string &varName,
+                          const std::string &confirmedBy) {
+  if (!reported[root].insert(varName).second) {
+    return;
+  }
+  if (confirmedBy != root) {
+    metricCount("races_confirmed_early", 1);
+  }
+  variablesReported.insert(varName);
+  // flushed per line so that readers see every race as it is confirmed
+  *stream << "{\"event\": \"race\", \"root\": \"" << escapeJson(root)
+          << "\", \"variable\": \"" << escapeJson(varName)
+          << "\", \"confirmed_by\": \"" << escapeJson(confirmedBy)
+          << "\", \"elapsed_ms\": " << elapsedMs() << "}" << std::endl;
+}
+
+void RaceReporter::retract(const std::string &root,
+                           const std::string &varName) {
+  reported[root].erase(varName);
+  metricCount("races_retracted", 1);
+  bool reportedElsewhere = false;
+  for (const auto &pair : reported) {
+    reportedElsewhere |= pair.second.find(varName) != pair.second.end();
+  }
+  if (!reportedElsewhere) {
+    variablesReported.erase(varName);
+  }
+  *stream << "{\"event\": \"retract\", \"root\": \"" << escapeJson(root)
+          << "\", \"variable\": \"" << escapeJson(varName)
+          << "\", \"elapsed_ms\": " << elapsedMs() << "}" << std::endl;
+}
+
+long long RaceReporter::elapsedMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - startTime)
+      .count();
+}
@@ -0,0 +1,149 @@
+#include "summary_cache.h"
+#include "metrics.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+static const std::string entryHeader = "eraser-summary 1";
+
+SummaryCache::SummaryCache(std::string directory) : directory(directory){};
+
+// entries are spread over subdirectories named by the first two characters
+// of their key
+std::string SummaryCache::getPath(const std::string &key) {
+  return directory + "/" + key.substr(0, 2) + "/" + key;
+}
+
+// one tab separated line per element, the maps of threads are unordered so
+// their lines are sorted, and the variables are sorted by name
+std::string SummaryCache::describe(const EraserSets &sets,
+                                   const VarTable &varTable) {
+  std::string description = "";
+  for (const std::string &lock : sets.locks) {
+    description += "lock\t" + lock + "\n";
+  }
+  for (const std::string &unlock : sets.unlocks) {
+    description += "unlock\t" + unlock + "\n";
+  }
+  for (VarId var : varTable.sortByName(sets.vars.getVars())) {
+    description += "var\t" + varTable.getName(var) + "\t" +
+                   std::to_string(sets.vars.get(var)) + "\n";
+  }
+  std::set<std::string> threadLines;
+  for (const auto &pair : sets.queuedWrites) {
+    for (VarId write : pair.second) {
+      threadLines.insert("queued\t" + pair.first + "\t" +
+                         varTable.getName(write) + "\n");
+    }
+  }
+  for (VarId var = 0; var < sets.activeThreads.varEnd(); var++) {
+    for (const std::string &tid : sets.activeThreads.getTids(var)) {
+      threadLines.insert("active\t" + varTable.getName(var) + "\t" + tid +
+                         "\n");
+    }
+  }
+  for (const std::string &line : threadLines) {
+    description += line;
+  }
+  for (VarId thread : varTable.sortByName(sets.finishedThreads)) {
+    description += "finished\t" + varTable.getName(thread) + "\n";
+  }
+  description += "ignore\t" + std::to_string(sets.eraserIgnoreOn) + "\n";
+  return description;
+}
+
+bool SummaryCache::load(const std::string &key, CachedSummary &summary,
+                        VarTable &varTable) {
+  std::ifstream file(getPath(key));
+  std::string line;
+  if (!file.is_open() || !std::getline(file, line) || line != entryHeader) {
+    metricCount("summary_cache_misses", 1);
+    return false;
+  }
+  summary = {};
+  while (std::getline(file, line)) {
+    // names may be empty, e.g. a thread joined without a variable
+    std::vector<std::string> fields = {""};
+    for (char c : line) {
+      if (c == '\t') {
+        fields.push_back("");
+      } else {
+        fields.back() += c;
+      }
+    }
+    if (fields.size() < 2) {
+      continue;
+    }
+    const std::string &kind = fields[0];
+    if (kind == "lock") {
+      summary.sets.locks.insert(fields[1]);
+    } else if (kind == "unlock") {
+      summary.sets.unlocks.insert(fields[1]);
+    } else if (kind == "var" && fields.size() == 3) {
+      summary.sets.vars.set(varTable.intern(fields[1]), std::stoi(fields[2]));
+    } else if (kind == "queued" && fields.size() == 3) {
+      summary.sets.queuedWrites.insert(fields[1], varTable.intern(fields[2]));
+    } else if (kind == "active" && fields.size() == 3) {
+      summary.sets.activeThreads.insert(varTable.intern(fields[1]), fields[2]);
+    } else if (kind == "finished") {
+      summary.sets.finishedThreads.insert(varTable.intern(fields[1]));
+    } else if (kind == "ignore") {
+      summary.sets.eraserIgnoreOn = fields[1] == "1";
+    } else if (kind == "read") {
+      summary.reads.insert(varTable.intern(fields[1]));
+    } else if (kind == "write") {
+      summary.writes.insert(varTable.intern(fields[1]));
+    } else if (kind == "recursive_unlock") {
+      summary.recursiveUnlocks.insert(fields[1]);
+    } else if (kind == "node_flags") {
+      for (char flag : fields[1]) {
+        summary.ignoreFlags.push_back(flag == '1');
+      }
+    }
+  }
+  metricCount("summary_cache_hits", 1);
+  return true;
+}
+
+void SummaryCache::store(const std::string &key,
+                         const CachedSummary &summary,
+                         const VarTable &varTable) {
+  std::string path = getPath(key);
+  if (std::filesystem::exists(path)) {
+    return;
+  }
+  std::string contents = entryHeader + "\n" + describe(summary.sets, varTable);
+  for (VarId read : varTable.sortByName(summary.reads)) {
+    contents += "read\t" + varTable.getName(read) + "\n";
+  }
+  for (VarId write : varTable.sortByName(summary.writes)) {
+    contents += "write\t" + varTable.getName(write) + "\n";
+  }
+  for (const std::string &unlock : summary.recursiveUnlocks) {
+    contents += "recursive_unlock\t" + unlock + "\n";
+  }
+  contents += "node_flags\t";
+  for (bool flag : summary.ignoreFlags) {
+    contents += flag ? "1" : "0";
+  }
+  contents += "\n";
+
+  std::error_code error;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), error);
+  std::string tempPath = path + "." + std::to_string(getpid()) + ".tmp";
+  std::ofstream file(tempPath);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open " << tempPath << " for writing." << std::endl;
+    return;
+  }
+  file << contents;
+  file.close();
+  std::filesystem::rename(tempPath, path, error);
+  if (error) {
+    std::remove(tempPath.c_str());
+    return;
+  }
+  metricCount("summary_cache_stores", 1);
+}
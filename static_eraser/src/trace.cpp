@@ -0,0 +1,123 @@
+#include "trace.h"
+#include <fstream>
+#include <iostream>
+
+std::string escapeJson(const std::string &value) {
+  std::string result;
+  for (char c : value) {
+    switch (c) {
+    case '"':
+      result += "\\\"";
+      break;
+    case '\\':
+      result += "\\\\";
+      break;
+    case '\n':
+      result += "\\n";
+      break;
+    case '\t':
+      result += "\\t";
+      break;
+    default:
+      if ((unsigned char)c < 0x20) {
+        result += ' ';
+      } else {
+        result += c;
+      }
+    }
+  }
+  return result;
+}
+
+Tracer &Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::start(const std::string &path) {
+  std::lock_guard<std::mutex> lock(mutex);
+  this->path = path;
+  origin = std::chrono::steady_clock::now();
+  events.clear();
+  enabled = true;
+}
+
+bool Tracer::isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+long long Tracer::now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - origin)
+      .count();
+}
+
+int Tracer::threadId() {
+  thread_local int id = 0;
+  if (id == 0) {
+    id = nextThreadId++;
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.push_back(id);
+  }
+  return id;
+}
+
+void Tracer::addSpan(const std::string &category, const std::string &name,
+                     const std::string &detail, long long start,
+                     long long duration) {
+  int thread = threadId();
+  std::lock_guard<std::mutex> lock(mutex);
+  events.push_back({category, name, detail, start, duration, thread});
+}
+
+bool Tracer::finish() {
+  enabled = false;
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open " << path << " for writing." << std::endl;
+    return false;
+  }
+  write(file);
+  return true;
+}
+
+void Tracer::write(std::ostream &stream) {
+  std::lock_guard<std::mutex> lock(mutex);
+  stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  stream << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+            "\"args\": {\"name\": \"static_eraser\"}}";
+  for (int thread : threads) {
+    std::string threadName =
+        thread == 1 ? "main" : "worker " + std::to_string(thread - 1);
+    stream << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+              "\"tid\": "
+           << thread << ", \"args\": {\"name\": \"" << threadName << "\"}}";
+  }
+  for (const TraceEvent &event : events) {
+    stream << ",\n{\"name\": \"" << escapeJson(event.name) << "\", \"cat\": \""
+           << escapeJson(event.category) << "\", \"ph\": \"X\", \"ts\": "
+           << event.start << ", \"dur\": " << event.duration
+           << ", \"pid\": 1, \"tid\": " << event.thread;
+    if (!event.detail.empty()) {
+      stream << ", \"args\": {\"detail\": \"" << escapeJson(event.detail)
+             << "\"}";
+    }
+    stream << "}";
+  }
+  stream << "\n]}\n";
+}
+
+TraceSpan::TraceSpan(const char *category, const std::string &name,
+                     const std::string &detail)
+    : active(Tracer::instance().isEnabled()), category(category) {
+  if (active) {
+    this->name = name;
+    this->detail = detail;
+    start = Tracer::instance().now();
+  }
+}
+
+TraceSpan::~TraceSpan() {
+  if (active) {
+    Tracer &tracer = Tracer::instance();
+    tracer.addSpan(category, name, detail, start, tracer.now() - start);
+  }
+}
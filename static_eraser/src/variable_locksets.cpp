@@ -1,6 +1,10 @@
 #include "variable_locksets.h"
 #include "debug_tools.h"
+#include "fnv_hash.h"
+#include "metrics.h"
+#include "trace.h"
 #include "set_operations.h"
+#include <cstdio>
 
 VariableLocksets::VariableLocksets(
     CallGraph *callGraph, Parser *parser,
@@ -114,6 +118,59 @@ bool VariableLocksets::handleNode(GraphNode *node,
   return true;
 };
 
+void VariableLocksets::removeVariableLocks(
+    std::string varName, std::set<std::string> &removedLocks) {
+  if (variableLocksets.find(varName) != variableLocksets.end()) {
+    variableLocksets[varName] -= removedLocks;
+  }
+}
+
+// Semi-naive counterpart of handleNode. Every transfer function here adds
+// and removes a fixed set of locks, so the locks removed from the lockset
+// on entry to node map to the locks removed on exit without revisiting the
+// locks that are still held.
+void VariableLocksets::handleRemovedLocks(GraphNode *node,
+                                          std::set<std::string> &removedLocks) {
+  if (auto *functionNode = dynamic_cast<FunctionCallNode *>(node)) {
+    std::string functionName = functionNode->functionName;
+    if (functionName != currFunc &&
+        funcCallLocksets.find(functionName) != funcCallLocksets.end()) {
+      funcCallLocksets[functionName] -= removedLocks;
+    }
+    functionVariableLocksets->applyDeltaLocksetToRemovedLocks(removedLocks,
+                                                              functionName);
+  } else if (auto *threadCreateNode = dynamic_cast<ThreadCreateNode *>(node)) {
+    if (threadCreateNode->global && threadCreateNode->varName != "" &&
+        !threadCreateNode->eraserIgnoreOn) {
+      removeVariableLocks(threadCreateNode->varName, removedLocks);
+    }
+  } else if (auto *threadJoinNode = dynamic_cast<ThreadJoinNode *>(node)) {
+    if (threadJoinNode->global && threadJoinNode->varName != "" &&
+        !threadJoinNode->eraserIgnoreOn) {
+      removeVariableLocks(threadJoinNode->varName, removedLocks);
+    }
+  } else if (auto *lockNode = dynamic_cast<LockNode *>(node)) {
+    removedLocks.erase(lockNode->varName);
+  } else if (auto *readNode = dynamic_cast<ReadNode *>(node)) {
+    if (!readNode->eraserIgnoreOn) {
+      removeVariableLocks(readNode->varName, removedLocks);
+    }
+  } else if (auto *writeNode = dynamic_cast<WriteNode *>(node)) {
+    if (!writeNode->eraserIgnoreOn) {
+      removeVariableLocks(writeNode->varName, removedLocks);
+    }
+  }
+}
+
+void VariableLocksets::removeNodeLocks(GraphNode *node,
+                                       std::set<std::string> &removedLocks) {
+  nodeLocks[node] -= removedLocks;
+  auto it = nodeRemovedLocks.find(node);
+  if (it != nodeRemovedLocks.end()) {
+    it->second += removedLocks;
+  }
+}
+
 void VariableLocksets::addNodeToQueue(GraphNode *startNode,
                                       GraphNode *nextNode) {
   if (startNode->id < nextNode->id) {
@@ -123,16 +180,113 @@ void VariableLocksets::addNodeToQueue(GraphNode *startNode,
   }
 }
 
-void VariableLocksets::handleFunction(GraphNode *startNode,
+// FNV-1a, only used to key the phase 2 memo
+static std::string hashString(const std::string &str) {
+  uint64_t hash = fnvHash(str.data(), str.size());
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+  return hex;
+}
+
+// Hashes everything the dataflow depends on besides the locks held on entry:
+// the nodes in discovery order, their edges and ignore flags and the lock
+// summary of every callee.
+std::string VariableLocksets::getCfgHash(GraphNode *startNode) {
+  std::unordered_map<GraphNode *, size_t> indices = {{startNode, 0}};
+  std::vector<GraphNode *> nodes = {startNode};
+  std::string description = "";
+  for (size_t i = 0; i < nodes.size(); i++) {
+    GraphNode *node = nodes[i];
+    description += std::to_string(i) + " " + node->getPrintableName();
+    if (node->eraserIgnoreOn) {
+      description += " ignored";
+    }
+    if (auto *functionNode = dynamic_cast<FunctionCallNode *>(node)) {
+      std::set<std::string> locks;
+      std::set<std::string> unlocks;
+      functionVariableLocksets->getFunctionLocks(functionNode->functionName,
+                                                 locks, unlocks);
+      for (const std::string &lock : locks) {
+        description += " +" + lock;
+      }
+      for (const std::string &unlock : unlocks) {
+        description += " -" + unlock;
+      }
+    }
+    description += " ->";
+    for (GraphNode *nextNode : node->getNextNodes()) {
+      if (indices.find(nextNode) == indices.end()) {
+        indices.insert({nextNode, nodes.size()});
+        nodes.push_back(nextNode);
+      }
+      description += " " + std::to_string(indices[nextNode]);
+    }
+    description += "\n";
+  }
+  return hashString(description);
+}
+
+void VariableLocksets::handleFunction(StartNode *startNode,
                                       std::set<std::string> &startLocks) {
   variableLocksets = {};
   funcCallLocksets = {};
+  if (startNode->kind == CFG_TRIVIAL) {
+    // no accesses or calls, so nothing to record
+    metricCount("vl_trivial_functions", 1);
+  } else {
+    std::set<std::string> inputLocks = startLocks - currRecursiveUnlocks;
+    if (!functionVariableLocksets->getMemoisedLocksets(
+            currCfgHash, inputLocks, funcCallLocksets, variableLocksets)) {
+      widened = false;
+      if (startNode->kind == CFG_ACYCLIC) {
+        runLinearPass(startNode, inputLocks);
+      } else {
+        runDataflow(startNode, inputLocks);
+      }
+      if (widened) {
+        // not memoised, a larger budget may reach the fixed point
+        widenFunction(startNode);
+      } else {
+        functionVariableLocksets->memoiseLocksets(currCfgHash, inputLocks,
+                                                  funcCallLocksets,
+                                                  variableLocksets);
+      }
+    }
+  }
+  functionVariableLocksets->addFuncCallLocksets(funcCallLocksets);
+  functionVariableLocksets->addVariableLocksets(variableLocksets);
+}
+
+// See DeltaLockset::runLinearPass
+void VariableLocksets::runLinearPass(StartNode *startNode,
+                                     std::set<std::string> &startLocks) {
+  nodeLocks = {};
+  nodeLocks.insert({startNode, startLocks});
+  for (GraphNode *node : startNode->getNodesInIdOrder()) {
+    std::set<std::string> locks = nodeLocks[node];
+    for (GraphNode *nextNode : node->getNextNodes()) {
+      std::set<std::string> nextLocks = locks;
+      handleNode(nextNode, nextLocks);
+      auto it = nodeLocks.find(nextNode);
+      if (it == nodeLocks.end()) {
+        nodeLocks.insert({nextNode, nextLocks});
+      } else {
+        it->second *= nextLocks;
+      }
+    }
+  }
+  metricCount("vl_linear_passes", 1);
+}
+
+void VariableLocksets::runDataflow(GraphNode *startNode,
+                                   std::set<std::string> &startLocks) {
   forwardQueue.push(startNode);
   nodeLocks = {};
-  nodeLocks.insert(
-      {startNode,
-       startLocks - functionVariableLocksets->getFunctionRecursiveUnlocks()});
-  int lastId = -1;
+  nodeLocks.insert({startNode, startLocks});
+  nodeRemovedLocks = {};
+  int pops = 0;
+  int requeues = 0;
+  BudgetTracker budgetTracker(budget);
 
   while (!forwardQueue.empty() || !backwardQueue.empty()) {
     if (forwardQueue.empty()) {
@@ -143,14 +297,41 @@ void VariableLocksets::handleFunction(GraphNode *startNode,
     }
 
     GraphNode *node = forwardQueue.top();
-    std::set<std::string> locks = nodeLocks[node];
     forwardQueue.pop();
-    if (node->id == lastId) {
+    pops++;
+    if (budgetTracker.exceeded(pops, nodeLocks[node].size() +
+                                         variableLocksets.size())) {
+      widened = true;
+      forwardQueue = {};
+      backwardQueue.clear();
+      break;
+    }
+    std::vector<GraphNode *> nextNodes = node->getNextNodes();
+
+    auto removed = nodeRemovedLocks.find(node);
+    if (removed != nodeRemovedLocks.end()) {
+      // revisit, only propagate the locks removed since the last visit
+      if (removed->second.empty()) {
+        continue;
+      }
+      std::set<std::string> removedLocks = {};
+      removedLocks.swap(removed->second);
+
+      for (GraphNode *nextNode : nextNodes) {
+        std::set<std::string> nextRemovedLocks = removedLocks;
+        handleRemovedLocks(nextNode, nextRemovedLocks);
+        nextRemovedLocks *= nodeLocks[nextNode];
+        if (!nextRemovedLocks.empty()) {
+          requeues++;
+          removeNodeLocks(nextNode, nextRemovedLocks);
+          addNodeToQueue(node, nextNode);
+        }
+      }
       continue;
     }
-    lastId = node->id;
 
-    std::vector<GraphNode *> nextNodes = node->getNextNodes();
+    nodeRemovedLocks.insert({node, {}});
+    std::set<std::string> locks = nodeLocks[node];
     for (GraphNode *nextNode : nextNodes) {
       std::set<std::string> nextLocks = locks;
 
@@ -159,34 +340,45 @@ void VariableLocksets::handleFunction(GraphNode *startNode,
           nodeLocks.insert({nextNode, nextLocks});
           addNodeToQueue(node, nextNode);
         } else {
-          nextLocks *= nodeLocks[nextNode];
+          std::set<std::string> nextRemovedLocks =
+              nodeLocks[nextNode] - nextLocks;
 
-          if (nextLocks != nodeLocks[nextNode]) {
-            nodeLocks[nextNode] = nextLocks;
+          if (!nextRemovedLocks.empty()) {
+            requeues++;
+            removeNodeLocks(nextNode, nextRemovedLocks);
             addNodeToQueue(node, nextNode);
           }
         }
       }
     }
   }
-  functionVariableLocksets->addFuncCallLocksets(funcCallLocksets);
-  functionVariableLocksets->addVariableLocksets(variableLocksets);
+  metricCount("vl_worklist_pops", pops);
+  metricCount("vl_worklist_requeues", requeues);
+  metricObserve("vl_worklist_pops_per_function", pops);
+  metricObserve("vl_worklist_requeues_per_function", requeues);
 }
 
-void VariableLocksets::updateLocksets() {
+void VariableLocksets::updateLocksets() { visitFunctions(getOrdering()); }
 
+std::vector<std::string> VariableLocksets::getOrdering() {
   std::vector<std::string> functions =
       functionVariableLocksets->getFunctionsForTesting();
 
-  std::vector<std::string> ordering =
-      callGraph->functionVariableLocksetsOrdering(functions);
+  return callGraph->functionVariableLocksetsOrdering(functions);
+}
 
-  for (const std::string &funcName : ordering) {
+void VariableLocksets::visitFunctions(
+    const std::vector<std::string> &ordering) {
+  int start = checkpoints == nullptr ? 0 : checkpoints->getPosition();
+  for (size_t i = start; i < ordering.size(); i++) {
+    const std::string &funcName = ordering[i];
     if (!functionVariableLocksets->shouldVisitNode(funcName)) {
       debugCout << "VL SKIPPING " << funcName << std::endl;
       continue;
     }
     debugCout << "VL looking at: " << funcName << std::endl;
+    TraceSpan span("phase2", funcName);
+    functionsVisited++;
     currFunc = funcName;
     functionVariableLocksets->startNewFunction(currFunc);
     FunctionInputs functionInputs =
@@ -195,23 +387,30 @@ void VariableLocksets::updateLocksets() {
         functionInputs.changedTests;
 
     debugCout << "Function: " << funcName << std::endl;
+    currCfgHash = "";
+    currRecursiveUnlocks =
+        functionVariableLocksets->getFunctionRecursiveUnlocks();
     for (const auto &pair : combinedInputs) {
       currTest = pair.first;
+      TraceSpan testSpan("phase2_test", currTest);
       functionVariableLocksets->startNewTest(currTest);
       std::set<std::string> startLocks = pair.second;
       if (funcCfgs.find(funcName) == funcCfgs.end()) {
         std::string fileName = callGraph->getFilenameFromFuncname(funcName);
         parser->parseFile(fileName.c_str());
       }
+      if (currCfgHash == "" && funcCfgs[funcName]->kind != CFG_TRIVIAL) {
+        currCfgHash = getCfgHash(funcCfgs[funcName]);
+      }
       handleFunction(funcCfgs[funcName], startLocks);
 
-      std::unordered_map<std::string, std::set<std::string>> variableLocks =
-          functionVariableLocksets->getVariableLocks();
+      VariableLocks variableLocks = functionVariableLocksets->getVariableLocks();
 
       debugCout << "Test: " << currTest << std::endl;
       for (const auto &pair : variableLocks) {
         std::string varName = pair.first;
-        std::set<std::string> locks = pair.second;
+        std::set<std::string> locks =
+            functionVariableLocksets->getLocksetTable()->get(pair.second);
         debugCout << "Variable: " << varName << std::endl;
         debugCout << "Locks: ";
         for (const std::string &lock : locks) {
@@ -221,5 +420,61 @@ void VariableLocksets::updateLocksets() {
       }
     }
     debugCout << std::endl;
+    if (checkpoints != nullptr) {
+      checkpoints->itemFinished(i + 1);
+    }
   }
+}
+
+// Stands in for the dataflow of a function that ran out of budget, every
+// access and call is treated as made with no locks held.
+void VariableLocksets::widenFunction(StartNode *startNode) {
+  variableLocksets = {};
+  funcCallLocksets = {};
+  for (GraphNode *node : startNode->getNodesInIdOrder()) {
+    if (auto *functionNode = dynamic_cast<FunctionCallNode *>(node)) {
+      if (functionNode->functionName != currFunc) {
+        funcCallLocksets[functionNode->functionName] = {};
+      }
+    } else if (auto *threadCreateNode =
+                   dynamic_cast<ThreadCreateNode *>(node)) {
+      funcCallLocksets[threadCreateNode->functionName] = {};
+      if (threadCreateNode->global && threadCreateNode->varName != "" &&
+          !threadCreateNode->eraserIgnoreOn) {
+        variableLocksets[threadCreateNode->varName] = {};
+      }
+    } else if (auto *threadJoinNode = dynamic_cast<ThreadJoinNode *>(node)) {
+      if (threadJoinNode->global && threadJoinNode->varName != "" &&
+          !threadJoinNode->eraserIgnoreOn) {
+        variableLocksets[threadJoinNode->varName] = {};
+      }
+    } else if (auto *readNode = dynamic_cast<ReadNode *>(node)) {
+      if (!readNode->eraserIgnoreOn) {
+        variableLocksets[readNode->varName] = {};
+      }
+    } else if (auto *writeNode = dynamic_cast<WriteNode *>(node)) {
+      if (!writeNode->eraserIgnoreOn) {
+        variableLocksets[writeNode->varName] = {};
+      }
+    }
+  }
+  if (widenedFunctions.empty() || widenedFunctions.back() != currFunc) {
+    widenedFunctions.push_back(currFunc);
+    callGraph->markNodeAsWidened(currFunc);
+    metricCount("vl_functions_widened", 1);
+  }
+}
+
+void VariableLocksets::setBudget(const FunctionBudget &budget) {
+  this->budget = budget;
+}
+
+void VariableLocksets::setCheckpoints(Checkpoints *checkpoints) {
+  this->checkpoints = checkpoints;
+}
+
+int VariableLocksets::getFunctionsVisited() { return functionsVisited; }
+
+std::vector<std::string> VariableLocksets::getWidenedFunctions() {
+  return widenedFunctions;
 }
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "database.h"
+#include "lockset_table.h"
+#include <iostream>
+#include <set>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &description) {
+  if (!condition) {
+    std::cerr << "FAILED: " << description << std::endl;
+    failures++;
+  }
+}
+
+int main() {
+  Database db(false, ":memory:");
+  db.createTables();
+  LocksetTable locksetTable(&db);
+
+  // lock names may be empty, and a lockset holding such a lock must not be
+  // mistaken for the empty lockset
+  LocksetId empty = locksetTable.intern({});
+  LocksetId emptyName = locksetTable.intern({""});
+  check(empty != emptyName, "{} and {\"\"} have different ids");
+  check(locksetTable.getEmpty() == empty, "getEmpty() is the id of {}");
+  check(locksetTable.get(emptyName) == std::set<std::string>{""},
+        "{\"\"} is returned as {\"\"}");
+
+  LocksetId ab = locksetTable.intern({"a", "b"});
+  LocksetId bc = locksetTable.intern({"b", "c"});
+  check(locksetTable.intern({"b", "a"}) == ab, "equal locksets share an id");
+  check(locksetTable.get(locksetTable.intersect(ab, bc)) ==
+            std::set<std::string>{"b"},
+        "{a, b} * {b, c} is {b}");
+  check(locksetTable.intersect(ab, emptyName) == empty,
+        "{a, b} * {\"\"} is {}");
+
+  // a second table on the same connection starts with empty caches, so every
+  // lockset is decoded from its row
+  LocksetTable reloaded(&db);
+  for (const std::set<std::string> &locks :
+       std::set<std::set<std::string>>{{}, {""}, {"", "a"}, {"a", "b"}}) {
+    LocksetId id = locksetTable.intern(locks);
+    check(reloaded.get(id) == locks, "a lockset of size " +
+                                         std::to_string(locks.size()) +
+                                         " survives a reload");
+    check(reloaded.intern(locks) == id,
+          "a reloaded lockset keeps its id");
+  }
+
+  if (failures == 0) {
+    std::cout << "All lockset table checks passed" << std::endl;
+  }
+  return failures == 0 ? 0 : 1;
+}
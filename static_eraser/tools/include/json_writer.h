@@ -0,0 +1,43 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Minimal streaming JSON writer for the machine readable tool reports.
+class JsonWriter {
+public:
+  explicit JsonWriter(std::ostream &stream);
+  virtual ~JsonWriter() = default;
+
+  void beginObject();
+  void beginObject(const std::string &key);
+  void endObject();
+  void beginArray();
+  void beginArray(const std::string &key);
+  void endArray();
+
+  void value(const std::string &value);
+  void value(const char *value);
+  void value(double value);
+  void value(int value);
+  void value(long value);
+  void value(long long value);
+  void value(unsigned long value);
+  void value(bool value);
+
+  template <typename T> void field(const std::string &key, T fieldValue) {
+    writeKey(key);
+    value(fieldValue);
+  }
+
+  static std::string escape(const std::string &text);
+
+private:
+  std::ostream &stream;
+  std::vector<bool> firstInScope = {};
+  bool afterKey = false;
+
+  void separate();
+  void writeKey(const std::string &key);
+  void newline();
+};
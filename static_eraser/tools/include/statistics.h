@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+struct SampleSummary {
+  std::size_t count;
+  double min;
+  double max;
+  double mean;
+  double median;
+  double p90;
+  double p95;
+  double p99;
+};
+
+double percentile(const std::vector<double> &sortedSamples, double fraction);
+SampleSummary summarizeSamples(std::vector<double> samples);
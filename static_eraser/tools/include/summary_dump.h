@@ -0,0 +1,22 @@
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Rows of every summary table with row ids replaced by the function and test
+// they belong to, so that two databases analysing the same code compare equal
+// regardless of the order their rows were written in.
+typedef std::map<std::string, std::set<std::string>> SummaryDump;
+
+struct TableMismatch {
+  std::string table;
+  std::vector<std::string> missing;
+  std::vector<std::string> unexpected;
+};
+
+SummaryDump dumpSummaries(const std::string &dbPath);
+
+// Differences of `actual` against `expected`, one entry per differing table.
+std::vector<TableMismatch> compareSummaries(SummaryDump &expected,
+                                            SummaryDump &actual);
@@ -0,0 +1,30 @@
+#pragma once
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+
+// Source files of a fixture, named the same way DiffAnalysis::getAllFiles
+// names them. A fixture may also be a single C file.
+std::set<std::string> listSourceFiles(const std::string &fixturePath);
+
+// Largest .c file of a fixture, used as the edited file for incremental runs.
+std::string largestSourceFile(const std::set<std::string> &files);
+
+double millisecondsSince(std::chrono::steady_clock::time_point start);
+
+// Returns the value of "--name=value" style arguments.
+bool readOption(const std::string &arg, const std::string &name,
+                std::string &value);
+
+// Swallows everything the analysis prints to std::cout while alive.
+class SilencedOutput {
+public:
+  explicit SilencedOutput();
+  virtual ~SilencedOutput();
+
+private:
+  std::ostringstream sink;
+  std::streambuf *original;
+};
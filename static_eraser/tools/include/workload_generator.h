@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+struct WorkloadParameters {
+  uint64_t seed = 1;
+  int functions = 200;
+  int files = 8;
+  // functions are split into this many levels, calls go to deeper levels
+  int depth = 8;
+  int fanout = 3;
+  // chance of each function calling back into a shallower level
+  double recursion = 0.05;
+  int globals = 50;
+  int locks = 8;
+  int loopDepth = 2;
+  int statements = 6;
+  // thread create sites in main, and the share of them that are joined
+  int threads = 4;
+  double joined = 1.0;
+  // chance of a function creating and joining its own thread
+  double threadDensity = 0.02;
+  int commits = 5;
+  // share of functions rewritten by each commit
+  double mutate = 0.05;
+};
+
+// Emits a C project with a layered call graph of pthread code, followed by a
+// sequence of commits that each rewrite the bodies of a share of the
+// functions. The output only depends on the parameters, so the same seed
+// always produces the same project.
+class WorkloadGenerator {
+public:
+  explicit WorkloadGenerator(WorkloadParameters parameters);
+  virtual ~WorkloadGenerator() = default;
+
+  // writes outputDir/commit_<i> for every commit and a replay manifest,
+  // returns the path of the manifest
+  std::string generate(const std::string &outputDir);
+
+private:
+  struct FunctionShape {
+    int file;
+    int level;
+    std::vector<int> callees;
+    std::vector<int> recursiveCallees;
+    // index into workers, -1 unless the function creates a thread
+    int worker;
+    int version;
+  };
+
+  WorkloadParameters parameters;
+  std::mt19937_64 engine;
+  std::vector<FunctionShape> shapes;
+  // entry function of every thread worker, main's workers come first
+  std::vector<int> workers;
+
+  uint64_t uniform(uint64_t bound);
+  bool chance(double probability);
+
+  void buildCallGraph();
+  std::vector<int> mutateFunctions(int commit);
+
+  std::string functionName(int function);
+  std::string globalName(int global);
+  std::string lockName(int lock);
+  std::string functionBody(int function);
+  void emitStatements(std::string &code, int indent, int loopLevel,
+                      int &count, std::vector<std::string> &calls);
+
+  void writeSnapshot(const std::string &snapshotDir);
+  std::string headerFile();
+  std::string globalsFile();
+  std::string mainFile();
+  std::string sourceFile(int file);
+};
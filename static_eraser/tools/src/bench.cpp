@@ -0,0 +1,250 @@
+#include "analysis_pipeline.h"
+#include "database.h"
+#include "json_writer.h"
+#include "statistics.h"
+#include "tool_utils.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef ERASER_VERSION
+#define ERASER_VERSION "unknown"
+#endif
+
+// phases in pipeline order, "total" covers the whole run
+static const std::vector<std::string> phaseNames = {
+    "parse",    "phase1",         "phase2", "phase3",
+    "finalize", "race_detection", "total"};
+
+static const std::vector<std::string> defaultFixtures = {
+    "Splash-3/d8959049c25c116b010bbbc8c38e4d9fced3e984/barnes",
+    "Splash-3/d8959049c25c116b010bbbc8c38e4d9fced3e984/ocean_non_contiguous",
+    "Splash-3/d8959049c25c116b010bbbc8c38e4d9fced3e984/volrend",
+    "Splash-4/altered/barnes",
+    "Splash-4/altered/cholesky",
+    "Splash-4/altered/ocean-non_contiguous_partitions",
+    "Splash-4/altered/fft.c",
+    "largest_check_multi_file"};
+
+struct BenchOptions {
+  int repetitions = 5;
+  int warmup = 1;
+  bool incremental = true;
+  std::string testFiles = "test_files";
+  std::string workDir = "bench_work";
+  std::string output = "bench.json";
+  std::vector<std::string> fixtures = {};
+};
+
+typedef std::map<std::string, std::vector<double>> PhaseSamples;
+
+struct FixtureResult {
+  std::string name;
+  std::string path;
+  size_t files;
+  std::string incrementalFile;
+  size_t races;
+  PhaseSamples initial;
+  PhaseSamples incremental;
+};
+
+size_t runPipeline(const std::string &dbPath, bool initialCommit,
+                   const std::set<std::string> &changedFiles,
+                   PhaseSamples &samples) {
+  SilencedOutput silenced;
+  auto startTime = std::chrono::steady_clock::now();
+
+  Database db(initialCommit, dbPath);
+  AnalysisPipeline pipeline(&db);
+
+  auto phaseStart = std::chrono::steady_clock::now();
+  pipeline.parseChangedFiles(changedFiles);
+  samples["parse"].push_back(millisecondsSince(phaseStart));
+
+  phaseStart = std::chrono::steady_clock::now();
+  pipeline.updateDeltaLocksets();
+  samples["phase1"].push_back(millisecondsSince(phaseStart));
+
+  phaseStart = std::chrono::steady_clock::now();
+  pipeline.updateVariableLocksets();
+  samples["phase2"].push_back(millisecondsSince(phaseStart));
+
+  phaseStart = std::chrono::steady_clock::now();
+  pipeline.updateCumulativeLocksets();
+  samples["phase3"].push_back(millisecondsSince(phaseStart));
+
+  phaseStart = std::chrono::steady_clock::now();
+  pipeline.markResultsAsOld();
+  samples["finalize"].push_back(millisecondsSince(phaseStart));
+
+  phaseStart = std::chrono::steady_clock::now();
+  std::set<std::string> dataRaces = pipeline.detectDataRaces();
+  samples["race_detection"].push_back(millisecondsSince(phaseStart));
+
+  samples["total"].push_back(millisecondsSince(startTime));
+  return dataRaces.size();
+}
+
+FixtureResult benchFixture(const std::string &name, const std::string &path,
+                           const BenchOptions &options) {
+  FixtureResult result = {name, path, 0, "", 0, {}, {}};
+  std::set<std::string> files = listSourceFiles(path);
+  result.files = files.size();
+  result.incrementalFile = largestSourceFile(files);
+
+  std::string dbPath = options.workDir + "/eraser.db";
+  std::string initialDbPath = options.workDir + "/initial.db";
+
+  PhaseSamples discarded;
+  for (int i = 0; i < options.warmup; i++) {
+    runPipeline(dbPath, true, files, discarded);
+  }
+  for (int i = 0; i < options.repetitions; i++) {
+    result.races = runPipeline(dbPath, true, files, result.initial);
+  }
+
+  if (!options.incremental || result.incrementalFile == "") {
+    return result;
+  }
+
+  // every incremental run starts from the state left by an initial run
+  std::filesystem::copy_file(dbPath, initialDbPath,
+                             std::filesystem::copy_options::overwrite_existing);
+  std::set<std::string> changedFiles = {result.incrementalFile};
+  for (int i = 0; i < options.warmup + options.repetitions; i++) {
+    std::filesystem::copy_file(
+        initialDbPath, dbPath,
+        std::filesystem::copy_options::overwrite_existing);
+    runPipeline(dbPath, false, changedFiles,
+                i < options.warmup ? discarded : result.incremental);
+  }
+  return result;
+}
+
+void writeSamples(JsonWriter &json, const std::string &key,
+                  PhaseSamples &samples) {
+  json.beginObject(key);
+  for (const std::string &phase : phaseNames) {
+    SampleSummary summary = summarizeSamples(samples[phase]);
+    json.beginObject(phase);
+    json.field("count", summary.count);
+    json.field("min_ms", summary.min);
+    json.field("max_ms", summary.max);
+    json.field("mean_ms", summary.mean);
+    json.field("median_ms", summary.median);
+    json.field("p90_ms", summary.p90);
+    json.field("p95_ms", summary.p95);
+    json.field("p99_ms", summary.p99);
+    json.beginArray("samples_ms");
+    for (double sample : samples[phase]) {
+      json.value(sample);
+    }
+    json.endArray();
+    json.endObject();
+  }
+  json.endObject();
+}
+
+void writeReport(std::ostream &stream, const BenchOptions &options,
+                 std::vector<FixtureResult> &results) {
+  JsonWriter json(stream);
+  json.beginObject();
+  json.field("tool", "static_eraser_bench");
+  json.field("version", ERASER_VERSION);
+  json.field("repetitions", options.repetitions);
+  json.field("warmup", options.warmup);
+  json.beginArray("fixtures");
+  for (FixtureResult &result : results) {
+    json.beginObject();
+    json.field("name", result.name);
+    json.field("path", result.path);
+    json.field("files", result.files);
+    json.field("races", result.races);
+    json.field("incremental_file", result.incrementalFile);
+    writeSamples(json, "initial", result.initial);
+    if (!result.incremental.empty()) {
+      writeSamples(json, "incremental", result.incremental);
+    }
+    json.endObject();
+  }
+  json.endArray();
+  json.endObject();
+}
+
+void printSummary(const std::string &label, PhaseSamples &samples) {
+  std::cout << "  " << label << ":";
+  for (const std::string &phase : phaseNames) {
+    SampleSummary summary = summarizeSamples(samples[phase]);
+    std::cout << " " << phase << "=" << summary.median << "ms";
+  }
+  std::cout << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  BenchOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    std::string value;
+    if (readOption(arg, "repetitions", value)) {
+      options.repetitions = std::stoi(value);
+    } else if (readOption(arg, "warmup", value)) {
+      options.warmup = std::stoi(value);
+    } else if (readOption(arg, "test-files", value)) {
+      options.testFiles = value;
+    } else if (readOption(arg, "work-dir", value)) {
+      options.workDir = value;
+    } else if (readOption(arg, "output", value)) {
+      options.output = value;
+    } else if (readOption(arg, "fixture", value)) {
+      options.fixtures.push_back(value);
+    } else if (arg == "--no-incremental") {
+      options.incremental = false;
+    } else {
+      std::cout << "Expected usage: static_eraser_bench [--repetitions=N] "
+                   "[--warmup=N] [--test-files=DIR] [--work-dir=DIR] "
+                   "[--output=FILE] [--fixture=PATH]... [--no-incremental]"
+                << std::endl;
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  std::vector<std::pair<std::string, std::string>> fixtures;
+  if (options.fixtures.empty()) {
+    for (const std::string &fixture : defaultFixtures) {
+      fixtures.push_back({fixture, options.testFiles + "/" + fixture});
+    }
+  } else {
+    for (const std::string &fixture : options.fixtures) {
+      fixtures.push_back({fixture, fixture});
+    }
+  }
+
+  std::filesystem::create_directories(options.workDir);
+
+  std::vector<FixtureResult> results;
+  for (const auto &fixture : fixtures) {
+    if (!std::filesystem::exists(fixture.second)) {
+      std::cerr << "Skipping missing fixture " << fixture.second << std::endl;
+      continue;
+    }
+    std::cout << "Benchmarking " << fixture.first << std::endl;
+    results.push_back(benchFixture(fixture.first, fixture.second, options));
+    printSummary("initial", results.back().initial);
+    if (!results.back().incremental.empty()) {
+      printSummary("incremental", results.back().incremental);
+    }
+  }
+
+  std::ofstream outFile(options.output);
+  if (!outFile.is_open()) {
+    std::cerr << "Failed to open " << options.output << " for writing."
+              << std::endl;
+    return 1;
+  }
+  writeReport(outFile, options, results);
+  std::cout << "Wrote " << options.output << std::endl;
+  return 0;
+}
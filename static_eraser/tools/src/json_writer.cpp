@@ -0,0 +1,142 @@
+#include "json_writer.h"
+#include <cmath>
+#include <cstdio>
+
+JsonWriter::JsonWriter(std::ostream &stream) : stream(stream) {}
+
+std::string JsonWriter::escape(const std::string &text) {
+  std::string result;
+  for (char c : text) {
+    switch (c) {
+    case '"':
+      result += "\\\"";
+      break;
+    case '\\':
+      result += "\\\\";
+      break;
+    case '\n':
+      result += "\\n";
+      break;
+    case '\t':
+      result += "\\t";
+      break;
+    case '\r':
+      result += "\\r";
+      break;
+    default:
+      if ((unsigned char)c < 0x20) {
+        char buffer[8];
+        std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+        result += buffer;
+      } else {
+        result += c;
+      }
+    }
+  }
+  return result;
+}
+
+void JsonWriter::newline() {
+  stream << "\n" << std::string(2 * firstInScope.size(), ' ');
+}
+
+void JsonWriter::separate() {
+  if (afterKey) {
+    afterKey = false;
+    return;
+  }
+  if (firstInScope.empty()) {
+    return;
+  }
+  if (!firstInScope.back()) {
+    stream << ",";
+  }
+  firstInScope.back() = false;
+  newline();
+}
+
+void JsonWriter::writeKey(const std::string &key) {
+  separate();
+  stream << "\"" << escape(key) << "\": ";
+  afterKey = true;
+}
+
+void JsonWriter::beginObject() {
+  separate();
+  stream << "{";
+  firstInScope.push_back(true);
+}
+
+void JsonWriter::beginObject(const std::string &key) {
+  writeKey(key);
+  beginObject();
+}
+
+void JsonWriter::endObject() {
+  bool empty = firstInScope.back();
+  firstInScope.pop_back();
+  if (!empty) {
+    newline();
+  }
+  stream << "}";
+  if (firstInScope.empty()) {
+    stream << "\n";
+  }
+}
+
+void JsonWriter::beginArray() {
+  separate();
+  stream << "[";
+  firstInScope.push_back(true);
+}
+
+void JsonWriter::beginArray(const std::string &key) {
+  writeKey(key);
+  beginArray();
+}
+
+void JsonWriter::endArray() {
+  bool empty = firstInScope.back();
+  firstInScope.pop_back();
+  if (!empty) {
+    newline();
+  }
+  stream << "]";
+}
+
+void JsonWriter::value(const std::string &value) {
+  separate();
+  stream << "\"" << escape(value) << "\"";
+}
+
+void JsonWriter::value(const char *value) { this->value(std::string(value)); }
+
+void JsonWriter::value(double value) {
+  separate();
+  if (!std::isfinite(value)) {
+    stream << "null";
+    return;
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+  stream << buffer;
+}
+
+void JsonWriter::value(int value) { this->value((long long)value); }
+
+void JsonWriter::value(long value) { this->value((long long)value); }
+
+void JsonWriter::value(long long value) {
+  separate();
+  stream << value;
+}
+
+void JsonWriter::value(unsigned long value) {
+  separate();
+  stream << value;
+}
+
+void JsonWriter::value(bool value) {
+  separate();
+  stream << (value ? "true" : "false");
+}
@@ -0,0 +1,589 @@
+#include "analysis_pipeline.h"
+#include "database.h"
+#include "json_writer.h"
+#include "set_operations.h"
+#include "summary_dump.h"
+#include "tool_utils.h"
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef ERASER_VERSION
+#define ERASER_VERSION "unknown"
+#endif
+
+static const std::vector<std::string> phaseNames = {
+    "parse",    "phase1",         "phase2", "phase3",
+    "finalize", "race_detection", "total"};
+
+static const std::vector<std::string> visitedPhases = {"phase1", "phase2",
+                                                       "phase3"};
+
+// mismatching rows reported per table, the counts are always complete
+static const size_t maxReportedRows = 20;
+
+struct ReplayOptions {
+  std::vector<std::string> snapshots = {};
+  std::string gitRepo = "";
+  std::vector<std::string> commits = {};
+  std::string range = "";
+  std::string subdir = "";
+  std::string workDir = "replay_work";
+  std::string output = "replay.json";
+  bool verify = true;
+  // incremental runs stream their races with --priority and check them
+  // against the races detected afterwards
+  bool streamRaces = false;
+  std::set<std::string> roots = {"main"};
+};
+
+struct ReplayStep {
+  std::string label;
+  std::string source;
+};
+
+struct SnapshotChanges {
+  std::set<std::string> changed;
+  std::set<std::string> deleted;
+};
+
+struct RunStats {
+  std::map<std::string, double> phases;
+  std::map<std::string, int> visited;
+  long long statements;
+  std::uintmax_t dbBytes;
+  std::set<std::string> races;
+  std::set<std::string> streamedRaces;
+};
+
+struct StepResult {
+  std::string label;
+  size_t files;
+  std::set<std::string> analysedFiles;
+  SnapshotChanges changes;
+  RunStats incremental;
+  RunStats scratch;
+  std::vector<TableMismatch> mismatches;
+  bool equivalent;
+  bool streamMatches;
+};
+
+std::string readCommandOutput(const std::string &command) {
+  std::array<char, 128> buffer;
+  std::string result;
+  std::unique_ptr<FILE, int (*)(FILE *)> pipe(
+      popen(command.c_str(), "r"), static_cast<int (*)(FILE *)>(pclose));
+  if (!pipe) {
+    throw std::runtime_error("popen() failed!");
+  }
+  while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
+    result += buffer.data();
+  }
+  return result;
+}
+
+std::string quote(const std::string &arg) {
+  std::string quoted = "'";
+  for (char c : arg) {
+    quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+  }
+  return quoted + "'";
+}
+
+bool sameContents(const std::filesystem::path &a,
+                  const std::filesystem::path &b) {
+  if (std::filesystem::file_size(a) != std::filesystem::file_size(b)) {
+    return false;
+  }
+  std::ifstream streamA(a, std::ios::binary);
+  std::ifstream streamB(b, std::ios::binary);
+  std::ostringstream contentsA, contentsB;
+  contentsA << streamA.rdbuf();
+  contentsB << streamB.rdbuf();
+  return contentsA.str() == contentsB.str();
+}
+
+bool isSourceFile(const std::filesystem::path &path) {
+  return path.extension() == ".c" || path.extension() == ".h";
+}
+
+std::set<std::string> listFiles(const std::string &root) {
+  std::set<std::string> files;
+  for (auto it = std::filesystem::recursive_directory_iterator(root);
+       it != std::filesystem::recursive_directory_iterator(); ++it) {
+    if (it->is_directory() && it->path().filename() == ".git") {
+      it.disable_recursion_pending();
+    } else if (it->is_regular_file()) {
+      files.insert(std::filesystem::relative(it->path(), root).string());
+    }
+  }
+  return files;
+}
+
+// Makes `tree` an exact copy of `snapshot`, the tree keeps a stable path so
+// the filenames stored in the database stay valid between steps. Only files
+// whose contents differ are rewritten.
+SnapshotChanges syncSnapshot(const std::string &snapshot,
+                             const std::string &tree) {
+  SnapshotChanges changes = {{}, {}};
+  std::filesystem::create_directories(tree);
+  std::set<std::string> snapshotFiles = listFiles(snapshot);
+  std::set<std::string> treeFiles = listFiles(tree);
+
+  for (const std::string &file : snapshotFiles) {
+    std::filesystem::path source = std::filesystem::path(snapshot) / file;
+    std::filesystem::path target = std::filesystem::path(tree) / file;
+    if (treeFiles.find(file) != treeFiles.end() &&
+        sameContents(source, target)) {
+      continue;
+    }
+    std::filesystem::create_directories(target.parent_path());
+    std::filesystem::copy_file(
+        source, target, std::filesystem::copy_options::overwrite_existing);
+    if (isSourceFile(target)) {
+      changes.changed.insert(target.string());
+    }
+  }
+
+  for (const std::string &file : treeFiles) {
+    if (snapshotFiles.find(file) != snapshotFiles.end()) {
+      continue;
+    }
+    std::filesystem::path target = std::filesystem::path(tree) / file;
+    std::filesystem::remove(target);
+    if (isSourceFile(target)) {
+      changes.deleted.insert(target.string());
+    }
+  }
+  return changes;
+}
+
+// Checks a commit out into `exportDir` without touching the repository's own
+// working tree.
+bool exportCommit(const std::string &repo, const std::string &commit,
+                  const std::string &subdir, const std::string &exportDir) {
+  std::filesystem::remove_all(exportDir);
+  std::filesystem::create_directories(exportDir);
+  std::string command = "git -C " + quote(repo) + " archive --format=tar " +
+                        quote(commit) + (subdir == "" ? "" : " " + quote(subdir)) +
+                        " | tar -x -C " + quote(exportDir);
+  return std::system(command.c_str()) == 0;
+}
+
+std::vector<std::string> readManifest(const std::string &manifestPath) {
+  std::vector<std::string> snapshots;
+  std::ifstream manifest(manifestPath);
+  if (!manifest.is_open()) {
+    std::cerr << "Failed to open manifest " << manifestPath << std::endl;
+    return snapshots;
+  }
+  std::filesystem::path base = std::filesystem::path(manifestPath).parent_path();
+  std::string line;
+  while (std::getline(manifest, line)) {
+    line.erase(0, line.find_first_not_of(" \t"));
+    line.erase(line.find_last_not_of(" \t\r") + 1);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::filesystem::path snapshot = line;
+    snapshots.push_back(
+        snapshot.is_absolute() ? line : (base / snapshot).string());
+  }
+  return snapshots;
+}
+
+std::vector<std::string> splitList(const std::string &list) {
+  std::vector<std::string> items;
+  std::istringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+std::vector<ReplayStep> collectSteps(const ReplayOptions &options) {
+  std::vector<ReplayStep> steps;
+  if (options.gitRepo == "") {
+    for (const std::string &snapshot : options.snapshots) {
+      steps.push_back({snapshot, snapshot});
+    }
+    return steps;
+  }
+
+  std::vector<std::string> commits = options.commits;
+  if (options.range != "") {
+    // the range start is analysed from scratch, like the first snapshot
+    std::string start = options.range.substr(0, options.range.find(".."));
+    commits.push_back(start);
+    std::istringstream stream(readCommandOutput(
+        "git -C " + quote(options.gitRepo) + " rev-list --reverse " +
+        quote(options.range)));
+    std::string commit;
+    while (std::getline(stream, commit)) {
+      if (!commit.empty()) {
+        commits.push_back(commit);
+      }
+    }
+  }
+  std::string exportDir = options.workDir + "/export";
+  std::string source =
+      options.subdir == "" ? exportDir : exportDir + "/" + options.subdir;
+  for (const std::string &commit : commits) {
+    steps.push_back({commit, source});
+  }
+  return steps;
+}
+
+// the value of a string field of a JSON line written by the race reporter
+std::string readStringField(const std::string &line, const std::string &name) {
+  std::string key = "\"" + name + "\": \"";
+  size_t start = line.find(key);
+  if (start == std::string::npos) {
+    return "";
+  }
+  std::string value;
+  for (size_t i = start + key.size(); i < line.size() && line[i] != '"'; i++) {
+    if (line[i] == '\\' && i + 1 < line.size()) {
+      i++;
+    }
+    value += line[i];
+  }
+  return value;
+}
+
+// the variables of the races left in a race stream once retractions are
+// applied
+std::set<std::string> readStreamedRaces(const std::string &contents) {
+  std::set<std::pair<std::string, std::string>> rootRaces;
+  std::istringstream stream(contents);
+  std::string line;
+  while (std::getline(stream, line)) {
+    std::string event = readStringField(line, "event");
+    std::pair<std::string, std::string> race = {
+        readStringField(line, "root"), readStringField(line, "variable")};
+    if (event == "race") {
+      rootRaces.insert(race);
+    } else if (event == "retract") {
+      rootRaces.erase(race);
+    }
+  }
+  std::set<std::string> races;
+  for (const auto &race : rootRaces) {
+    races.insert(race.second);
+  }
+  return races;
+}
+
+RunStats runAnalysis(const std::string &dbPath, bool initialCommit,
+                     const SnapshotChanges &changes,
+                     std::set<std::string> &analysedFiles,
+                     const std::set<std::string> &roots,
+                     bool streamRaces = false) {
+  RunStats stats = {{}, {}, 0, 0, {}, {}};
+  {
+    SilencedOutput silenced;
+    auto startTime = std::chrono::steady_clock::now();
+
+    Database db(initialCommit, dbPath);
+    AnalysisPipeline pipeline(&db);
+    pipeline.setRoots(roots);
+    std::ostringstream raceStream;
+    if (streamRaces) {
+      pipeline.setPriorityOrdering(true);
+      pipeline.setRaceStream(&raceStream);
+    }
+
+    // the same expansion DiffAnalysis applies to files changed in a commit
+    analysedFiles = changes.changed;
+    analysedFiles += changes.deleted;
+    if (!initialCommit) {
+      for (const std::string &file : changes.changed) {
+        analysedFiles += pipeline.getFileIncludes()->getChildren(file);
+      }
+    }
+
+    auto phaseStart = std::chrono::steady_clock::now();
+    pipeline.parseChangedFiles(analysedFiles);
+    stats.phases["parse"] = millisecondsSince(phaseStart);
+
+    phaseStart = std::chrono::steady_clock::now();
+    stats.visited["phase1"] = pipeline.updateDeltaLocksets();
+    stats.phases["phase1"] = millisecondsSince(phaseStart);
+
+    phaseStart = std::chrono::steady_clock::now();
+    stats.visited["phase2"] = pipeline.updateVariableLocksets();
+    stats.phases["phase2"] = millisecondsSince(phaseStart);
+
+    phaseStart = std::chrono::steady_clock::now();
+    stats.visited["phase3"] = pipeline.updateCumulativeLocksets();
+    stats.phases["phase3"] = millisecondsSince(phaseStart);
+
+    // the functions --priority left until after phase 3
+    phaseStart = std::chrono::steady_clock::now();
+    stats.visited["phase1"] += pipeline.updateDeferredDeltaLocksets();
+    stats.phases["phase1"] += millisecondsSince(phaseStart);
+
+    phaseStart = std::chrono::steady_clock::now();
+    pipeline.markResultsAsOld();
+    stats.phases["finalize"] = millisecondsSince(phaseStart);
+
+    phaseStart = std::chrono::steady_clock::now();
+    stats.races = pipeline.detectDataRaces();
+    stats.phases["race_detection"] = millisecondsSince(phaseStart);
+
+    stats.phases["total"] = millisecondsSince(startTime);
+    stats.statements = db.getStatementCount();
+    stats.streamedRaces = readStreamedRaces(raceStream.str());
+  }
+  stats.dbBytes = std::filesystem::file_size(dbPath);
+  return stats;
+}
+
+void writeRunStats(JsonWriter &json, const std::string &key,
+                   RunStats &stats) {
+  json.beginObject(key);
+  json.beginObject("phases_ms");
+  for (const std::string &phase : phaseNames) {
+    json.field(phase, stats.phases[phase]);
+  }
+  json.endObject();
+  json.beginObject("functions_visited");
+  for (const std::string &phase : visitedPhases) {
+    json.field(phase, stats.visited[phase]);
+  }
+  json.endObject();
+  json.field("sql_statements", stats.statements);
+  json.field("db_bytes", static_cast<unsigned long>(stats.dbBytes));
+  json.beginArray("races");
+  for (const std::string &race : stats.races) {
+    json.value(race);
+  }
+  json.endArray();
+  json.endObject();
+}
+
+void writeFileList(JsonWriter &json, const std::string &key,
+                   const std::set<std::string> &files) {
+  json.beginArray(key);
+  for (const std::string &file : files) {
+    json.value(file);
+  }
+  json.endArray();
+}
+
+void writeRows(JsonWriter &json, const std::string &key,
+               const std::vector<std::string> &rows) {
+  json.field(key + "_count", rows.size());
+  json.beginArray(key);
+  for (size_t i = 0; i < rows.size() && i < maxReportedRows; i++) {
+    json.value(rows[i]);
+  }
+  json.endArray();
+}
+
+void writeReport(std::ostream &stream, const ReplayOptions &options,
+                 std::vector<StepResult> &results) {
+  JsonWriter json(stream);
+  json.beginObject();
+  json.field("tool", "static_eraser_replay");
+  json.field("version", ERASER_VERSION);
+  json.field("source", options.gitRepo == "" ? "snapshots" : options.gitRepo);
+  json.field("verified", options.verify);
+
+  double incrementalTotal = 0;
+  double scratchTotal = 0;
+  int equivalentSteps = 0;
+  json.beginArray("steps");
+  for (size_t i = 0; i < results.size(); i++) {
+    StepResult &result = results[i];
+    json.beginObject();
+    json.field("index", i);
+    json.field("label", result.label);
+    json.field("files", result.files);
+    writeFileList(json, "changed_files", result.changes.changed);
+    writeFileList(json, "deleted_files", result.changes.deleted);
+    writeFileList(json, "analysed_files", result.analysedFiles);
+    writeRunStats(json, "incremental", result.incremental);
+    if (options.streamRaces) {
+      json.field("streamed_races_equal", result.streamMatches);
+    }
+    if (options.verify) {
+      writeRunStats(json, "scratch", result.scratch);
+      json.field("speedup", result.scratch.phases["total"] /
+                                result.incremental.phases["total"]);
+      json.field("equivalent", result.equivalent);
+      json.beginArray("mismatches");
+      for (const TableMismatch &mismatch : result.mismatches) {
+        json.beginObject();
+        json.field("table", mismatch.table);
+        writeRows(json, "missing", mismatch.missing);
+        writeRows(json, "unexpected", mismatch.unexpected);
+        json.endObject();
+      }
+      json.endArray();
+    }
+    json.endObject();
+
+    // the first step is a from-scratch run itself
+    if (i > 0) {
+      incrementalTotal += result.incremental.phases["total"];
+      scratchTotal += result.scratch.phases["total"];
+    }
+    equivalentSteps += result.equivalent ? 1 : 0;
+  }
+  json.endArray();
+
+  json.beginObject("summary");
+  json.field("steps", results.size());
+  json.field("incremental_total_ms", incrementalTotal);
+  if (options.verify) {
+    json.field("scratch_total_ms", scratchTotal);
+    json.field("equivalent_steps", equivalentSteps);
+  }
+  json.endObject();
+  json.endObject();
+}
+
+int main(int argc, char *argv[]) {
+  ReplayOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    std::string value;
+    if (readOption(arg, "snapshot", value)) {
+      options.snapshots.push_back(value);
+    } else if (readOption(arg, "manifest", value)) {
+      for (const std::string &snapshot : readManifest(value)) {
+        options.snapshots.push_back(snapshot);
+      }
+    } else if (readOption(arg, "git", value)) {
+      options.gitRepo = value;
+    } else if (readOption(arg, "commits", value)) {
+      options.commits = splitList(value);
+    } else if (readOption(arg, "range", value)) {
+      options.range = value;
+    } else if (readOption(arg, "subdir", value)) {
+      options.subdir = value;
+    } else if (readOption(arg, "work-dir", value)) {
+      options.workDir = value;
+    } else if (readOption(arg, "output", value)) {
+      options.output = value;
+    } else if (arg == "--no-verify") {
+      options.verify = false;
+    } else if (arg == "--stream-races") {
+      options.streamRaces = true;
+    } else if (readOption(arg, "roots", value)) {
+      std::vector<std::string> roots = splitList(value);
+      options.roots = std::set<std::string>(roots.begin(), roots.end());
+    } else {
+      std::cout
+          << "Expected usage: static_eraser_replay (--manifest=FILE | "
+             "--snapshot=DIR... | --git=REPO (--commits=A,B,... | "
+             "--range=A..B) [--subdir=PATH]) [--work-dir=DIR] "
+             "[--output=FILE] [--no-verify] [--stream-races] [--roots=F,G,...]"
+          << std::endl;
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  std::vector<ReplayStep> steps = collectSteps(options);
+  if (steps.empty()) {
+    std::cerr << "Nothing to replay, pass --manifest, --snapshot or --git."
+              << std::endl;
+    return 1;
+  }
+
+  // the tree is rebuilt from the first step onwards
+  std::string tree = options.workDir + "/tree";
+  std::string incrementalDb = options.workDir + "/incremental.db";
+  std::string scratchDb = options.workDir + "/scratch.db";
+  std::filesystem::remove_all(tree);
+  std::filesystem::create_directories(options.workDir);
+
+  std::vector<StepResult> results;
+  bool allEquivalent = true;
+  for (size_t i = 0; i < steps.size(); i++) {
+    const ReplayStep &step = steps[i];
+    if (options.gitRepo != "" &&
+        !exportCommit(options.gitRepo, step.label, options.subdir,
+                      options.workDir + "/export")) {
+      std::cerr << "Failed to export commit " << step.label << std::endl;
+      return 1;
+    }
+    if (!std::filesystem::is_directory(step.source)) {
+      std::cerr << "Snapshot " << step.source << " is not a directory."
+                << std::endl;
+      return 1;
+    }
+
+    StepResult result;
+    result.label = step.label;
+    result.changes = syncSnapshot(step.source, tree);
+    std::set<std::string> allFiles = listSourceFiles(tree);
+    result.files = allFiles.size();
+    result.incremental =
+        runAnalysis(incrementalDb, i == 0, result.changes, result.analysedFiles,
+                    options.roots, options.streamRaces);
+    result.streamMatches =
+        !options.streamRaces ||
+        result.incremental.streamedRaces == result.incremental.races;
+    allEquivalent = allEquivalent && result.streamMatches;
+
+    result.equivalent = true;
+    if (options.verify) {
+      std::set<std::string> scratchFiles;
+      result.scratch =
+          runAnalysis(scratchDb, true, {allFiles, {}}, scratchFiles,
+                      options.roots);
+      SummaryDump expected = dumpSummaries(scratchDb);
+      SummaryDump actual = dumpSummaries(incrementalDb);
+      result.mismatches = compareSummaries(expected, actual);
+      result.equivalent = result.mismatches.empty() &&
+                          result.scratch.races == result.incremental.races;
+      allEquivalent = allEquivalent && result.equivalent;
+    }
+
+    std::cout << "Step " << i + 1 << "/" << steps.size() << " " << step.label
+              << ": " << result.analysedFiles.size() << " files analysed, "
+              << result.incremental.phases["total"] << "ms, visited "
+              << result.incremental.visited["phase1"] << "/"
+              << result.incremental.visited["phase2"] << "/"
+              << result.incremental.visited["phase3"] << " functions, "
+              << result.incremental.statements << " statements";
+    if (options.streamRaces) {
+      std::cout << ", streamed races "
+                << (result.streamMatches ? "match" : "DIFFERENT");
+    }
+    if (options.verify) {
+      std::cout << ", from scratch " << result.scratch.phases["total"]
+                << "ms, " << (result.equivalent ? "equivalent" : "DIFFERENT");
+      for (const TableMismatch &mismatch : result.mismatches) {
+        std::cout << std::endl
+                  << "  " << mismatch.table << ": " << mismatch.missing.size()
+                  << " missing, " << mismatch.unexpected.size()
+                  << " unexpected rows";
+      }
+    }
+    std::cout << std::endl;
+    results.push_back(result);
+  }
+
+  std::ofstream outFile(options.output);
+  if (!outFile.is_open()) {
+    std::cerr << "Failed to open " << options.output << " for writing."
+              << std::endl;
+    return 1;
+  }
+  writeReport(outFile, options, results);
+  std::cout << "Wrote " << options.output << std::endl;
+  return allEquivalent ? 0 : 2;
+}
@@ -0,0 +1,32 @@
+#include "statistics.h"
+#include <algorithm>
+#include <numeric>
+
+// linear interpolation between the closest ranks
+double percentile(const std::vector<double> &sortedSamples, double fraction) {
+  if (sortedSamples.empty()) {
+    return 0;
+  }
+  double rank = fraction * (sortedSamples.size() - 1);
+  std::size_t lower = (std::size_t)rank;
+  std::size_t upper = std::min(lower + 1, sortedSamples.size() - 1);
+  double weight = rank - lower;
+  return sortedSamples[lower] * (1 - weight) + sortedSamples[upper] * weight;
+}
+
+SampleSummary summarizeSamples(std::vector<double> samples) {
+  SampleSummary summary = {samples.size(), 0, 0, 0, 0, 0, 0, 0};
+  if (samples.empty()) {
+    return summary;
+  }
+  std::sort(samples.begin(), samples.end());
+  summary.min = samples.front();
+  summary.max = samples.back();
+  summary.mean =
+      std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+  summary.median = percentile(samples, 0.5);
+  summary.p90 = percentile(samples, 0.9);
+  summary.p95 = percentile(samples, 0.95);
+  summary.p99 = percentile(samples, 0.99);
+  return summary;
+}
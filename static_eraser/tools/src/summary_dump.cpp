@@ -0,0 +1,108 @@
+#include "summary_dump.h"
+#include <iostream>
+#include <sqlite3.h>
+
+// bookkeeping columns (recently_changed, marked, indegree...) are left out,
+// they legitimately differ between incremental and from-scratch runs
+static const std::vector<std::pair<std::string, std::string>> summaryQueries =
+    {{"functions_table", "SELECT funcname, filename FROM functions_table"},
+     {"function_calls",
+      "SELECT caller, callee, on_thread FROM function_calls"},
+     {"file_includes", "SELECT filename, included_file FROM file_includes"},
+     {"function_locks", "SELECT funcname, lock, type FROM function_locks"},
+     {"function_recursive_unlocks",
+      "SELECT funcname, varname FROM function_recursive_unlocks"},
+     {"function_vars", "SELECT funcname, varname, type FROM function_vars"},
+     {"queued_writes", "SELECT funcname, tid, varname FROM queued_writes"},
+     {"finished_threads", "SELECT funcname, varname FROM finished_threads"},
+     {"active_threads",
+      "SELECT funcname, varname, tid FROM active_threads"},
+     {"function_variable_locksets",
+      "SELECT funcname, testname FROM function_variable_locksets"},
+     {"function_variable_locksets_combined_inputs",
+      "SELECT fvl.funcname, fvl.testname, ci.lock FROM "
+      "function_variable_locksets_combined_inputs AS ci JOIN "
+      "function_variable_locksets AS fvl ON "
+      "ci.function_variable_locksets_id = fvl.id"},
+     {"function_variable_locksets_callers_locks",
+      "SELECT fvl.funcname, fvl.testname, fvlc.caller, fvlcl.lock FROM "
+      "function_variable_locksets_callers AS fvlc JOIN "
+      "function_variable_locksets AS fvl ON "
+      "fvlc.function_variable_locksets_id = fvl.id LEFT JOIN "
+      "function_variable_locksets_callers_locks AS fvlcl ON "
+      "fvlcl.function_variable_locksets_callers_id = fvlc.id"},
+     {"function_variable_locksets_outputs",
+      "SELECT fvl.funcname, fvl.testname, o.varname, l.locks FROM "
+      "function_variable_locksets_outputs AS o JOIN "
+      "function_variable_locksets AS fvl ON "
+      "o.function_variable_locksets_id = fvl.id JOIN locksets AS l ON "
+      "o.lockset_id = l.id"},
+     {"function_variable_direct_accesses",
+      "SELECT funcname, varname, type FROM function_variable_direct_accesses"},
+     {"function_cumulative_locksets_outputs",
+      "SELECT fcl.funcname, fcl.testname, o.varname, l.locks FROM "
+      "function_cumulative_locksets AS fcl LEFT JOIN "
+      "function_cumulative_locksets_outputs AS o ON "
+      "o.function_cumulative_locksets_id = fcl.id LEFT JOIN locksets AS l ON "
+      "o.lockset_id = l.id"},
+     {"function_cumulative_accesses",
+      "SELECT funcname, varname, type FROM function_cumulative_accesses"}};
+
+SummaryDump dumpSummaries(const std::string &dbPath) {
+  SummaryDump dump;
+  sqlite3 *db;
+  if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) !=
+      SQLITE_OK) {
+    std::cerr << "Error opening database: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_close(db);
+    return dump;
+  }
+
+  for (const auto &pair : summaryQueries) {
+    std::set<std::string> &rows = dump[pair.first];
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, pair.second.c_str(), -1, &stmt, nullptr) !=
+        SQLITE_OK) {
+      std::cerr << "Error preparing statement: " << sqlite3_errmsg(db)
+                << std::endl;
+      continue;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      std::string row = "";
+      for (int col = 0; col < sqlite3_column_count(stmt); col++) {
+        const char *text =
+            reinterpret_cast<const char *>(sqlite3_column_text(stmt, col));
+        row += (col == 0 ? "" : "\t") + std::string(text ? text : "NULL");
+      }
+      rows.insert(row);
+    }
+    sqlite3_finalize(stmt);
+  }
+  sqlite3_close(db);
+  return dump;
+}
+
+std::vector<TableMismatch> compareSummaries(SummaryDump &expected,
+                                            SummaryDump &actual) {
+  std::vector<TableMismatch> mismatches;
+  for (const auto &pair : summaryQueries) {
+    std::set<std::string> &expectedRows = expected[pair.first];
+    std::set<std::string> &actualRows = actual[pair.first];
+    if (expectedRows == actualRows) {
+      continue;
+    }
+    TableMismatch mismatch = {pair.first, {}, {}};
+    for (const std::string &row : expectedRows) {
+      if (actualRows.find(row) == actualRows.end()) {
+        mismatch.missing.push_back(row);
+      }
+    }
+    for (const std::string &row : actualRows) {
+      if (expectedRows.find(row) == expectedRows.end()) {
+        mismatch.unexpected.push_back(row);
+      }
+    }
+    mismatches.push_back(mismatch);
+  }
+  return mismatches;
+}
@@ -0,0 +1,54 @@
+#include "tool_utils.h"
+#include <filesystem>
+
+std::set<std::string> listSourceFiles(const std::string &fixturePath) {
+  std::set<std::string> files;
+  if (std::filesystem::is_regular_file(fixturePath)) {
+    files.insert(fixturePath);
+    return files;
+  }
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator(fixturePath)) {
+    std::string extension = entry.path().extension().string();
+    if (entry.is_regular_file() && (extension == ".c" || extension == ".h")) {
+      files.insert(entry.path().string());
+    }
+  }
+  return files;
+}
+
+std::string largestSourceFile(const std::set<std::string> &files) {
+  std::string largest = "";
+  std::uintmax_t largestSize = 0;
+  for (const std::string &file : files) {
+    if (std::filesystem::path(file).extension() != ".c") {
+      continue;
+    }
+    std::uintmax_t size = std::filesystem::file_size(file);
+    if (largest == "" || size > largestSize) {
+      largest = file;
+      largestSize = size;
+    }
+  }
+  return largest;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+bool readOption(const std::string &arg, const std::string &name,
+                std::string &value) {
+  std::string prefix = "--" + name + "=";
+  if (arg.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  value = arg.substr(prefix.size());
+  return true;
+}
+
+SilencedOutput::SilencedOutput() { original = std::cout.rdbuf(sink.rdbuf()); }
+
+SilencedOutput::~SilencedOutput() { std::cout.rdbuf(original); }
@@ -0,0 +1,62 @@
+#include "tool_utils.h"
+#include "workload_generator.h"
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[]) {
+  WorkloadParameters parameters;
+  std::string output = "workload";
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    std::string value;
+    if (readOption(arg, "seed", value)) {
+      parameters.seed = std::stoull(value);
+    } else if (readOption(arg, "functions", value)) {
+      parameters.functions = std::stoi(value);
+    } else if (readOption(arg, "files", value)) {
+      parameters.files = std::stoi(value);
+    } else if (readOption(arg, "depth", value)) {
+      parameters.depth = std::stoi(value);
+    } else if (readOption(arg, "fanout", value)) {
+      parameters.fanout = std::stoi(value);
+    } else if (readOption(arg, "recursion", value)) {
+      parameters.recursion = std::stod(value);
+    } else if (readOption(arg, "globals", value)) {
+      parameters.globals = std::stoi(value);
+    } else if (readOption(arg, "locks", value)) {
+      parameters.locks = std::stoi(value);
+    } else if (readOption(arg, "loop-depth", value)) {
+      parameters.loopDepth = std::stoi(value);
+    } else if (readOption(arg, "statements", value)) {
+      parameters.statements = std::stoi(value);
+    } else if (readOption(arg, "threads", value)) {
+      parameters.threads = std::stoi(value);
+    } else if (readOption(arg, "joined", value)) {
+      parameters.joined = std::stod(value);
+    } else if (readOption(arg, "thread-density", value)) {
+      parameters.threadDensity = std::stod(value);
+    } else if (readOption(arg, "commits", value)) {
+      parameters.commits = std::stoi(value);
+    } else if (readOption(arg, "mutate", value)) {
+      parameters.mutate = std::stod(value);
+    } else if (readOption(arg, "output", value)) {
+      output = value;
+    } else {
+      std::cout
+          << "Expected usage: static_eraser_workload [--seed=N] "
+             "[--functions=N] [--files=N] [--depth=N] [--fanout=N] "
+             "[--recursion=P] [--globals=N] [--locks=N] [--loop-depth=N] "
+             "[--statements=N] [--threads=N] [--joined=P] "
+             "[--thread-density=P] [--commits=N] [--mutate=P] [--output=DIR]"
+          << std::endl;
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  WorkloadGenerator generator(parameters);
+  std::string manifest = generator.generate(output);
+  std::cout << "Wrote " << parameters.commits + 1 << " commits to " << output
+            << ", replay them with static_eraser_replay --manifest="
+            << manifest << std::endl;
+  return 0;
+}
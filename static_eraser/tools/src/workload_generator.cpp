@@ -0,0 +1,332 @@
+#include "workload_generator.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// splitmix64 finaliser, spreads (seed, a, b) over the whole seed space
+static uint64_t mix(uint64_t seed, uint64_t a, uint64_t b) {
+  uint64_t x = seed ^ (a * 0x9E3779B97F4A7C15ULL) ^ (b * 0xC2B2AE3D27D4EB4FULL);
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+static void writeFile(const std::filesystem::path &path,
+                      const std::string &contents) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open " << path << " for writing." << std::endl;
+    return;
+  }
+  file << contents;
+}
+
+static std::string indentation(int indent) {
+  return std::string(indent * 2, ' ');
+}
+
+WorkloadGenerator::WorkloadGenerator(WorkloadParameters parameters)
+    : parameters(parameters) {
+  this->parameters.functions = std::max(1, parameters.functions);
+  this->parameters.files = std::max(1, parameters.files);
+  this->parameters.depth =
+      std::max(1, std::min(parameters.depth, this->parameters.functions));
+  this->parameters.globals = std::max(1, parameters.globals);
+  this->parameters.locks = std::max(1, parameters.locks);
+}
+
+// std distributions are implementation defined, the engine output is not
+uint64_t WorkloadGenerator::uniform(uint64_t bound) {
+  return bound == 0 ? 0 : engine() % bound;
+}
+
+bool WorkloadGenerator::chance(double probability) {
+  return (engine() >> 11) * 0x1.0p-53 < probability;
+}
+
+void WorkloadGenerator::buildCallGraph() {
+  engine.seed(mix(parameters.seed, 0, 0));
+  int functions = parameters.functions;
+  int depth = parameters.depth;
+
+  shapes.clear();
+  workers.clear();
+  std::vector<std::vector<int>> levels(depth);
+  for (int f = 0; f < functions; f++) {
+    int level = (int)((int64_t)f * depth / functions);
+    int file = (int)((int64_t)f * parameters.files / functions);
+    shapes.push_back({file, level, {}, {}, -1, 0});
+    levels[level].push_back(f);
+  }
+
+  for (int t = 0; t < parameters.threads; t++) {
+    workers.push_back(levels[0][uniform(levels[0].size())]);
+  }
+
+  std::vector<bool> called(functions, false);
+  for (int f = 0; f < functions; f++) {
+    FunctionShape &shape = shapes[f];
+    if (shape.level + 1 < depth) {
+      for (int i = 0; i < parameters.fanout; i++) {
+        // mostly the next level, sometimes skipping further down
+        int level = shape.level + 1;
+        if (chance(0.3)) {
+          level += uniform(depth - shape.level - 1);
+        }
+        int callee = levels[level][uniform(levels[level].size())];
+        if (std::find(shape.callees.begin(), shape.callees.end(), callee) ==
+            shape.callees.end()) {
+          shape.callees.push_back(callee);
+          called[callee] = true;
+        }
+      }
+      if (chance(parameters.threadDensity)) {
+        std::vector<int> &next = levels[shape.level + 1];
+        shape.worker = workers.size();
+        workers.push_back(next[uniform(next.size())]);
+      }
+    }
+    if (chance(parameters.recursion)) {
+      int level = uniform(shape.level + 1);
+      shape.recursiveCallees.push_back(levels[level][uniform(levels[level].size())]);
+    }
+  }
+
+  // every function below the first level is reachable from main
+  for (int f = 0; f < functions; f++) {
+    if (shapes[f].level > 0 && !called[f]) {
+      std::vector<int> &previous = levels[shapes[f].level - 1];
+      shapes[previous[uniform(previous.size())]].callees.push_back(f);
+    }
+  }
+}
+
+std::vector<int> WorkloadGenerator::mutateFunctions(int commit) {
+  engine.seed(mix(parameters.seed, commit, 1));
+  int functions = parameters.functions;
+  int count = (int)std::lround(parameters.mutate * functions);
+  if (parameters.mutate > 0) {
+    count = std::max(1, std::min(count, functions));
+  }
+
+  std::vector<int> order(functions);
+  for (int f = 0; f < functions; f++) {
+    order[f] = f;
+  }
+  for (int i = 0; i < count; i++) {
+    std::swap(order[i], order[i + uniform(functions - i)]);
+    shapes[order[i]].version++;
+  }
+  std::vector<int> mutated(order.begin(), order.begin() + count);
+  std::sort(mutated.begin(), mutated.end());
+  return mutated;
+}
+
+std::string WorkloadGenerator::functionName(int function) {
+  return "f_" + std::to_string(function);
+}
+
+std::string WorkloadGenerator::globalName(int global) {
+  return "g_" + std::to_string(global);
+}
+
+std::string WorkloadGenerator::lockName(int lock) {
+  return "lock_" + std::to_string(lock);
+}
+
+void WorkloadGenerator::emitStatements(std::string &code, int indent,
+                                       int loopLevel, int &count,
+                                       std::vector<std::string> &calls) {
+  std::string pad = indentation(indent);
+  int budget = parameters.statements;
+  while (count < budget) {
+    count++;
+    std::string global = globalName(uniform(parameters.globals));
+    int kind = uniform(100);
+    if (kind < 30) {
+      code += pad + (chance(0.5) ? "local += " + global + ";\n"
+                                 : global + " = local + n;\n");
+    } else if (kind < 55) {
+      std::string lock = lockName(uniform(parameters.locks));
+      code += pad + "pthread_mutex_lock(&" + lock + ");\n";
+      code += pad + "  " + global + " += local;\n";
+      if (!calls.empty() && chance(0.5)) {
+        code += pad + "  " + calls.back() + "\n";
+        calls.pop_back();
+      }
+      code += pad + "pthread_mutex_unlock(&" + lock + ");\n";
+    } else if (kind < 70 && loopLevel < parameters.loopDepth) {
+      std::string i = "i" + std::to_string(loopLevel);
+      code += pad + "for (int " + i + " = 0; " + i + " < n; " + i + "++) {\n";
+      code += pad + "  local += " + i + ";\n";
+      emitStatements(code, indent + 1, loopLevel + 1, count, calls);
+      code += pad + "}\n";
+      return;
+    } else if (kind < 80) {
+      code += pad + "if (" + global + " > n) {\n";
+      code += pad + "  " + global + "--;\n";
+      emitStatements(code, indent + 1, loopLevel, count, calls);
+      code += pad + "}\n";
+      return;
+    } else if (!calls.empty()) {
+      code += pad + calls.back() + "\n";
+      calls.pop_back();
+    } else {
+      code += pad + "local += " + global + ";\n";
+    }
+  }
+}
+
+std::string WorkloadGenerator::functionBody(int function) {
+  FunctionShape &shape = shapes[function];
+  engine.seed(mix(parameters.seed, function + 2, shape.version));
+
+  std::vector<std::string> calls;
+  for (int callee : shape.callees) {
+    calls.push_back(functionName(callee) + "(n);");
+  }
+  for (int callee : shape.recursiveCallees) {
+    calls.push_back("if (n > 0) { " + functionName(callee) + "(n - 1); }");
+  }
+  for (size_t i = calls.size(); i > 1; i--) {
+    std::swap(calls[i - 1], calls[uniform(i)]);
+  }
+
+  std::string code = "void " + functionName(function) + "(int n) {\n";
+  code += "  int local = n;\n";
+  if (shape.worker != -1) {
+    code += "  pthread_t thread;\n";
+    code += "  pthread_create(&thread, NULL, worker_" +
+            std::to_string(shape.worker) + ", NULL);\n";
+  }
+  // nested blocks return early, keep emitting until the budget is spent
+  int count = 0;
+  while (count < parameters.statements) {
+    emitStatements(code, 1, 0, count, calls);
+  }
+  for (const std::string &call : calls) {
+    code += "  " + call + "\n";
+  }
+  if (shape.worker != -1) {
+    code += "  pthread_join(thread, NULL);\n";
+  }
+  code += "}\n";
+  return code;
+}
+
+std::string WorkloadGenerator::headerFile() {
+  std::string code = "#ifndef WORKLOAD_H\n#define WORKLOAD_H\n\n";
+  code += "#include <pthread.h>\n#include <stddef.h>\n\n";
+  for (int g = 0; g < parameters.globals; g++) {
+    code += "extern int " + globalName(g) + ";\n";
+  }
+  code += "\n";
+  for (int l = 0; l < parameters.locks; l++) {
+    code += "extern pthread_mutex_t " + lockName(l) + ";\n";
+  }
+  code += "\n";
+  for (int f = 0; f < parameters.functions; f++) {
+    code += "void " + functionName(f) + "(int n);\n";
+  }
+  code += "\n";
+  for (size_t w = 0; w < workers.size(); w++) {
+    code += "void *worker_" + std::to_string(w) + "(void *arg);\n";
+  }
+  return code + "\n#endif\n";
+}
+
+std::string WorkloadGenerator::globalsFile() {
+  std::string code = "#include \"workload.h\"\n\n";
+  for (int g = 0; g < parameters.globals; g++) {
+    code += "int " + globalName(g) + " = 0;\n";
+  }
+  code += "\n";
+  for (int l = 0; l < parameters.locks; l++) {
+    code += "pthread_mutex_t " + lockName(l) + " = PTHREAD_MUTEX_INITIALIZER;\n";
+  }
+  return code;
+}
+
+std::string WorkloadGenerator::mainFile() {
+  std::string code = "#include \"workload.h\"\n\n";
+  std::string depth = std::to_string(parameters.depth);
+  for (size_t w = 0; w < workers.size(); w++) {
+    code += "void *worker_" + std::to_string(w) + "(void *arg) {\n";
+    code += "  " + functionName(workers[w]) + "(" + depth + ");\n";
+    code += "  return NULL;\n}\n\n";
+  }
+
+  int joined = (int)std::lround(parameters.joined * parameters.threads);
+  code += "int main() {\n";
+  for (int t = 0; t < parameters.threads; t++) {
+    code += "  pthread_t thread_" + std::to_string(t) + ";\n";
+  }
+  for (int t = 0; t < parameters.threads; t++) {
+    code += "  pthread_create(&thread_" + std::to_string(t) +
+            ", NULL, worker_" + std::to_string(t) + ", NULL);\n";
+  }
+  code += "  " + functionName(0) + "(" + depth + ");\n";
+  for (int t = 0; t < joined && t < parameters.threads; t++) {
+    code += "  pthread_join(thread_" + std::to_string(t) + ", NULL);\n";
+  }
+  return code + "  return 0;\n}\n";
+}
+
+std::string WorkloadGenerator::sourceFile(int file) {
+  std::string code = "#include \"workload.h\"\n";
+  for (int f = 0; f < parameters.functions; f++) {
+    if (shapes[f].file == file) {
+      code += "\n" + functionBody(f);
+    }
+  }
+  return code;
+}
+
+void WorkloadGenerator::writeSnapshot(const std::string &snapshotDir) {
+  std::filesystem::path dir = snapshotDir;
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  writeFile(dir / "workload.h", headerFile());
+  writeFile(dir / "globals.c", globalsFile());
+  writeFile(dir / "main.c", mainFile());
+  for (int file = 0; file < parameters.files; file++) {
+    writeFile(dir / ("module_" + std::to_string(file) + ".c"),
+              sourceFile(file));
+  }
+}
+
+std::string WorkloadGenerator::generate(const std::string &outputDir) {
+  std::filesystem::create_directories(outputDir);
+  buildCallGraph();
+
+  std::string manifest = "# generated by static_eraser_workload\n";
+  manifest += "# seed=" + std::to_string(parameters.seed) +
+              " functions=" + std::to_string(parameters.functions) +
+              " files=" + std::to_string(parameters.files) +
+              " depth=" + std::to_string(parameters.depth) +
+              " fanout=" + std::to_string(parameters.fanout) +
+              " recursion=" + std::to_string(parameters.recursion) +
+              " globals=" + std::to_string(parameters.globals) +
+              " locks=" + std::to_string(parameters.locks) +
+              " loop-depth=" + std::to_string(parameters.loopDepth) +
+              " statements=" + std::to_string(parameters.statements) +
+              " threads=" + std::to_string(parameters.threads) +
+              " joined=" + std::to_string(parameters.joined) +
+              " thread-density=" + std::to_string(parameters.threadDensity) +
+              " mutate=" + std::to_string(parameters.mutate) + "\n";
+
+  writeSnapshot(outputDir + "/commit_0");
+  manifest += "commit_0\n";
+  for (int commit = 1; commit <= parameters.commits; commit++) {
+    std::vector<int> mutated = mutateFunctions(commit);
+    writeSnapshot(outputDir + "/commit_" + std::to_string(commit));
+    manifest += "# " + std::to_string(mutated.size()) + " functions rewritten\n";
+    manifest += "commit_" + std::to_string(commit) + "\n";
+  }
+
+  std::string manifestPath = outputDir + "/workload.replay";
+  writeFile(manifestPath, manifest);
+  return manifestPath;
+}